@@ -0,0 +1,36 @@
+#!/bin/sh
+# --batch: evaluates one mission for N input lines and reports inputs/sec, with and without workers
+# usage: benchmarks/batch_throughput.sh [path/to/roslang] [inputs]
+
+ROSLANG=${1:-./roslang}
+INPUTS=${2:-10000}
+DIR=${TMPDIR:-/tmp}
+PROGRAM=$DIR/batch_throughput.dhtt
+
+cat > "$PROGRAM" <<'DHTT'
+input speed: int = 1
+input name: string = "bot"
+fun leg(i: int) -> int:
+    return i * speed + 1
+THEN:
+    @for i in range(20):
+        AND:
+            move(leg(i), name)
+            @if i % 3 == 0:
+                look(i)
+DHTT
+
+awk -v n="$INPUTS" 'BEGIN {
+    for (i = 0; i < n; i++)
+    {
+        printf "{\"speed\": %d, \"name\": \"robot%d\"}\n", i % 7, i
+    }
+}' > "$DIR/batch_throughput.jsonl"
+
+# --jobs 0 is the default, a worker per core
+for JOBS in 1 0; do
+    START=$(date +%s.%N)
+    "$ROSLANG" --batch "$DIR/batch_throughput.jsonl" --jobs $JOBS "$PROGRAM" > /dev/null
+    END=$(date +%s.%N)
+    echo "$START $END $INPUTS $JOBS" | awk '{ printf "%s: %.0f inputs/sec\n", $4 == 1 ? "1 worker" : "every core", $3 / ($2 - $1) }'
+done
@@ -0,0 +1,99 @@
+#!/bin/sh
+# @load fan-out: a tree of sibling loads that each do some work, timed with --jobs 1 and --jobs N.
+# the output of every run must match the serial one
+# usage: benchmarks/load_fanout.sh [path/to/roslang] [loads] [jobs]
+
+ROSLANG=${1:-./roslang}
+LOADS=${2:-64}
+JOBS=${3:-$(nproc)}
+DIR=${TMPDIR:-/tmp}/load_fanout
+mkdir -p "$DIR"
+
+cat > "$DIR/mission.dhtt" <<'END'
+input n: int = 0
+let total: int = 0
+let i: int = 0
+while i < 200000:
+    total = total + i % 7
+    i = i + 1
+print(n, total)
+THEN:
+    start(n)
+    finish(total)
+END
+
+awk -v loads="$LOADS" -v dir="$DIR" 'BEGIN {
+    printf "AND:\n"
+    for (i = 0; i < loads; i++)
+    {
+        printf "    @load(\"%s/mission.dhtt\", %d)\n", dir, i
+    }
+}' > "$DIR/main.dhtt"
+
+for jobs in 1 "$JOBS"; do
+    start=$(date +%s%N)
+    "$ROSLANG" --jobs "$jobs" "$DIR/main.dhtt" > "$DIR/out_$jobs.txt"
+    end=$(date +%s%N)
+    echo "--jobs $jobs: $(((end - start) / 1000000)) ms"
+done
+
+cmp -s "$DIR/out_1.txt" "$DIR/out_$JOBS.txt" || echo "output differs from --jobs 1"
+
+# loads inside @for, @if and @else, each next to a sibling load, must keep their order too
+cat > "$DIR/child.dhtt" <<'END'
+input n: int = 0
+print(n, "child")
+THEN:
+    child(n)
+END
+
+cat > "$DIR/nested.dhtt" <<END
+AND:
+    @for i in range(3):
+        @load("$DIR/child.dhtt", i)
+        @load("$DIR/child.dhtt", i + 10)
+        mid(i)
+    @load("$DIR/child.dhtt", 20)
+    @if true:
+        @load("$DIR/child.dhtt", 30)
+        mid(30)
+        @load("$DIR/child.dhtt", 31)
+    @load("$DIR/child.dhtt", 40)
+    @if false:
+        mid(50)
+    @else:
+        @load("$DIR/child.dhtt", 50)
+        @load("$DIR/child.dhtt", 51)
+    @load("$DIR/child.dhtt", 60)
+END
+
+for mode in "" --interpret; do
+    "$ROSLANG" $mode --jobs 1 "$DIR/nested.dhtt" > "$DIR/nested_1.txt"
+    "$ROSLANG" $mode --jobs "$JOBS" "$DIR/nested.dhtt" > "$DIR/nested_$JOBS.txt"
+    cmp -s "$DIR/nested_1.txt" "$DIR/nested_$JOBS.txt" || echo "nested loads${mode:+ with $mode} differ from --jobs 1"
+done
+
+# a load that fails prints what it printed before the error, after the loads before it, and the
+# first failing load in order is the one reported
+cat > "$DIR/failing.dhtt" <<'END'
+input n: int = 0
+print(n, "before")
+let zero: int = 0
+print(n / zero)
+THEN:
+    child(n)
+END
+
+cat > "$DIR/errors.dhtt" <<END
+AND:
+    @load("$DIR/child.dhtt", 1)
+    @load("$DIR/failing.dhtt", 2)
+    @load("$DIR/child.dhtt", 3)
+    @load("$DIR/failing.dhtt", 4)
+END
+
+for mode in "" --interpret; do
+    "$ROSLANG" $mode --jobs 1 "$DIR/errors.dhtt" > "$DIR/errors_1.txt" 2>&1
+    "$ROSLANG" $mode --jobs "$JOBS" "$DIR/errors.dhtt" > "$DIR/errors_$JOBS.txt" 2>&1
+    cmp -s "$DIR/errors_1.txt" "$DIR/errors_$JOBS.txt" || echo "failing loads${mode:+ with $mode} differ from --jobs 1"
+done
@@ -0,0 +1,28 @@
+#!/bin/sh
+# parse throughput: generates a 100k line program and reports lines/sec with --parse-only
+# usage: benchmarks/parse_throughput.sh [path/to/roslang] [lines]
+
+ROSLANG=${1:-./roslang}
+LINES=${2:-100000}
+FILE=${TMPDIR:-/tmp}/parse_throughput.dhtt
+
+# each function is 10 lines, followed by the tree
+awk -v lines="$LINES" 'BEGIN {
+    for (i = 0; i < (lines - 2) / 10; i++)
+    {
+        printf "fun f%d(a: int, b: float, c: string[]) -> int:\n", i
+        printf "    let x: int = a * 2 + %d %% 7 - a ** 2 / 3\n", i
+        printf "    let y: float = b * 1.5 + 2.25\n"
+        printf "    if x > 10 AND x != 12 OR a <= 3:\n"
+        printf "        print(\"f%d\", x, y, c[0])\n", i
+        printf "    for s in c:\n"
+        printf "        x = x + 1\n"
+        printf "    while x < 100:\n"
+        printf "        x = x > 50 ? x + 2 : x + 1\n"
+        printf "    return x\n"
+    }
+    printf "AND:\n"
+    printf "    done(1, 2.5, [1, 2, 3])\n"
+}' > "$FILE"
+
+"$ROSLANG" --parse-only "$FILE"
@@ -0,0 +1,27 @@
+#!/bin/sh
+# --serve: sends N requests for one cached program over stdin and reports the mean time per request
+# usage: benchmarks/serve_latency.sh [path/to/roslang] [requests]
+
+ROSLANG=${1:-./roslang}
+REQUESTS=${2:-2000}
+DIR=${TMPDIR:-/tmp}
+PROGRAM=$DIR/serve_latency.dhtt
+
+cat > "$PROGRAM" <<'DHTT'
+input speed: int = 1
+AND:
+    @for i in range(10):
+        move(i * speed)
+DHTT
+
+awk -v n="$REQUESTS" -v program="$PROGRAM" 'BEGIN {
+    for (i = 0; i < n; i++)
+    {
+        printf "{\"program\": \"%s\", \"inputs\": {\"speed\": %d}}\n", program, i
+    }
+}' > "$DIR/serve_latency.jsonl"
+
+START=$(date +%s.%N)
+"$ROSLANG" --serve - < "$DIR/serve_latency.jsonl" | grep -c '^ok'
+END=$(date +%s.%N)
+echo "$START $END $REQUESTS" | awk '{ printf "%.3f ms per request\n", ($2 - $1) * 1000 / $3 }'
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+// bump allocator that owns every node of one Program. nodes are never destroyed one by one:
+// the blocks are released together when the Program goes away, so nodes must not own
+// anything outside the arena
+struct Arena
+{
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<char *> blocks;
+    char *cursor = nullptr;
+    char *limit = nullptr;
+
+    Arena() {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena()
+    {
+        for (auto block : blocks)
+        {
+            free(block);
+        }
+    }
+
+    void *allocate(size_t size, size_t align)
+    {
+        char *start = (char *)(((size_t)cursor + align - 1) & ~(align - 1));
+        if (cursor == nullptr || start + size > limit)
+        {
+            size_t block_size = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            char *block = (char *)malloc(block_size);
+            if (block == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            blocks.push_back(block);
+            cursor = block;
+            limit = block + block_size;
+            start = (char *)(((size_t)cursor + align - 1) & ~(align - 1));
+        }
+
+        cursor = start + size;
+        return start;
+    }
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+};
+
+// a fixed array of child nodes living in the arena
+template <typename T>
+struct NodeList
+{
+    T **items = nullptr;
+    size_t count = 0;
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    T *operator[](size_t index) const
+    {
+        return items[index];
+    }
+
+    T **begin() const
+    {
+        return items;
+    }
+
+    T **end() const
+    {
+        return items + count;
+    }
+
+    std::reverse_iterator<T **> rbegin() const
+    {
+        return std::reverse_iterator<T **>(end());
+    }
+
+    std::reverse_iterator<T **> rend() const
+    {
+        return std::reverse_iterator<T **>(begin());
+    }
+};
+
+// collects a list while the parser reduces it, then packs it into a NodeList.
+// the cells live in the arena too, so building a list never touches the heap
+template <typename T>
+struct ListBuilder
+{
+    struct Cell
+    {
+        T *item;
+        Cell *next;
+    };
+
+    Cell *head = nullptr;
+    Cell *tail = nullptr;
+    size_t count = 0;
+
+    ListBuilder *append(Arena &arena, T *item)
+    {
+        auto cell = arena.make<Cell>(Cell{item, nullptr});
+        if (tail == nullptr)
+        {
+            head = cell;
+        }
+        else
+        {
+            tail->next = cell;
+        }
+        tail = cell;
+        count++;
+        return this;
+    }
+
+    NodeList<T> build(Arena &arena)
+    {
+        NodeList<T> list;
+        list.count = count;
+        list.items = (T **)arena.allocate(sizeof(T *) * (count == 0 ? 1 : count), alignof(T *));
+        size_t i = 0;
+        for (auto cell = head; cell != nullptr; cell = cell->next)
+        {
+            list.items[i++] = cell->item;
+        }
+        return list;
+    }
+};
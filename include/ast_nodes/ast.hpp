@@ -3,7 +3,14 @@
 #include <string>
 #include <vector>
 #include "visitors/visitor.hpp"
+#include "ast_nodes/operators.hpp"
+#include "value/string.hpp"
+#include "ast_nodes/arena.hpp"
 #include <memory>
+#include <mutex>
+
+// identifier fields refer to the lexer's interned strings, which outlive every Program.
+// nodes live in their Program's arena and refer to each other with plain pointers
 
 // expr nodes
 struct Expr;
@@ -58,32 +65,27 @@ struct ArrayType;
 struct FunctionType;
 
 // helper structs
-template <typename T>
-struct List;
 struct IdentifierType;
 
 // others
 struct Program;
+struct Native;          // a builtin, see standard_lib.hpp
+struct CompiledProgram; // the VM's bytecode, see vm/chunk.hpp
 
 // the root node of the AST
 struct Program
 {
-    std::vector<std::unique_ptr<Input>> inputs;
-    std::vector<std::unique_ptr<Stmt>> stmts;
-    std::unique_ptr<TreeNode> treeNode;
+    NodeList<Input> inputs;
+    NodeList<Stmt> stmts;
+    TreeNode *treeNode = nullptr;
+    int call_sites = 0; // CallExprs to functions, numbered by the Resolver
+    // owns every node above; handed over by the parser once the program is complete
+    std::unique_ptr<Arena> arena;
+    // compiled by the first VM to run the program, and shared by every VM after it, on any thread
+    std::shared_ptr<CompiledProgram> compiled;
+    std::mutex compile_mutex;
 
-    Program(std::vector<Input *> inputs, std::vector<Stmt *> stmts, TreeNode *treeNode) : treeNode(treeNode)
-    {
-        for (auto &input : inputs)
-        {
-            this->inputs.push_back(std::unique_ptr<Input>(input));
-        }
-        for (auto &stmt : stmts)
-        {
-            this->stmts.push_back(std::unique_ptr<Stmt>(stmt));
-        }
-    }
-    Program(std::vector<std::unique_ptr<Input>> inputs, std::vector<std::unique_ptr<Stmt>> stmts, TreeNode *treeNode) : inputs(std::move(inputs)), stmts(std::move(stmts)), treeNode(std::move(treeNode)) {}
+    Program(NodeList<Input> inputs, NodeList<Stmt> stmts, TreeNode *treeNode) : inputs(inputs), stmts(stmts), treeNode(treeNode) {}
 };
 
 struct ASTNode
@@ -94,11 +96,11 @@ struct ASTNode
 // Input nodes
 struct Input : ASTNode
 {
-    std::string identifier;
-    std::unique_ptr<Type> type;
+    const std::string &identifier;
+    Type *type = nullptr;
+    int slot = -1;
 
-    Input(std::string identifier, Type *type) : identifier(identifier), type(type) {}
-    Input(std::string identifier, std::unique_ptr<Type> type) : identifier(identifier), type(std::move(type)) {}
+    Input(String *identifier, Type *type) : identifier(identifier->chars), type(type) {}
 
     void accept(Visitor *v) override
     {
@@ -108,10 +110,9 @@ struct Input : ASTNode
 
 struct InputDefault : Input
 {
-    std::unique_ptr<Expr> value;
+    Expr *value = nullptr;
 
-    InputDefault(std::string identifier, Type *type, Expr *value) : Input(identifier, type), value(value) {}
-    InputDefault(std::string identifier, std::unique_ptr<Type> type, std::unique_ptr<Expr> value) : Input(identifier, type.get()), value(std::move(value)) {}
+    InputDefault(String *identifier, Type *type, Expr *value) : Input(identifier, type), value(value) {}
 };
 
 // Expr nodes
@@ -123,19 +124,11 @@ struct Expr : ASTNode
 
 struct LambdaExpr : Expr
 {
-    std::vector<std::unique_ptr<IdentifierType>> params;
-    std::unique_ptr<Type> return_type;
-    std::unique_ptr<Expr> expr;
+    NodeList<IdentifierType> params;
+    Type *return_type = nullptr;
+    Expr *expr = nullptr;
 
-    LambdaExpr(std::vector<IdentifierType *> params, Type *return_type, Expr *expr) : return_type(return_type), expr(expr)
-    {
-        for (auto &param : params)
-        {
-            this->params.push_back(std::unique_ptr<IdentifierType>(param));
-        }
-    }
-    LambdaExpr(std::vector<std::unique_ptr<IdentifierType>> params, std::unique_ptr<Type> return_type, std::unique_ptr<Expr> expr) : params(std::move(params)), return_type(std::move(return_type)), expr(std::move(expr)) {}
-    LambdaExpr(std::vector<std::unique_ptr<IdentifierType>> params, Type *return_type, Expr *expr) : return_type(return_type), expr(expr), params(std::move(params)) {}
+    LambdaExpr(NodeList<IdentifierType> params, Type *return_type, Expr *expr) : params(params), return_type(return_type), expr(expr) {}
 
     void accept(Visitor *v) override
     {
@@ -145,11 +138,12 @@ struct LambdaExpr : Expr
 
 struct AssignExpr : Expr
 {
-    std::string identifier;
-    std::unique_ptr<Expr> value;
+    const std::string &identifier;
+    int depth = -1;
+    int slot = -1;
+    Expr *value = nullptr;
 
-    AssignExpr(std::string identifier, Expr *value) : identifier(identifier), value(value) {}
-    AssignExpr(std::string identifier, std::unique_ptr<Expr> value) : identifier(identifier), value(std::move(value)) {}
+    AssignExpr(String *identifier, Expr *value) : identifier(identifier->chars), value(value) {}
 
     void accept(Visitor *v) override
     {
@@ -159,12 +153,13 @@ struct AssignExpr : Expr
 
 struct ArrayAssignExpr : Expr
 {
-    std::string identifier;
-    std::unique_ptr<Expr> index;
-    std::unique_ptr<Expr> value;
+    const std::string &identifier;
+    int depth = -1;
+    int slot = -1;
+    Expr *index = nullptr;
+    Expr *value = nullptr;
 
-    ArrayAssignExpr(std::string identifier, Expr *index, Expr *value) : identifier(identifier), index(index), value(value) {}
-    ArrayAssignExpr(std::string identifier, std::unique_ptr<Expr> index, std::unique_ptr<Expr> value) : identifier(identifier), index(std::move(index)), value(std::move(value)) {}
+    ArrayAssignExpr(String *identifier, Expr *index, Expr *value) : identifier(identifier->chars), index(index), value(value) {}
 
     void accept(Visitor *v) override
     {
@@ -174,12 +169,11 @@ struct ArrayAssignExpr : Expr
 
 struct TernaryExpr : Expr
 {
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<Expr> then_expr;
-    std::unique_ptr<Expr> else_expr;
+    Expr *condition = nullptr;
+    Expr *then_expr = nullptr;
+    Expr *else_expr = nullptr;
 
     TernaryExpr(Expr *condition, Expr *then_expr, Expr *else_expr) : condition(condition), then_expr(then_expr), else_expr(else_expr) {}
-    TernaryExpr(std::unique_ptr<Expr> condition, std::unique_ptr<Expr> then_expr, std::unique_ptr<Expr> else_expr) : condition(std::move(condition)), then_expr(std::move(then_expr)), else_expr(std::move(else_expr)) {}
 
     void accept(Visitor *v) override
     {
@@ -189,12 +183,12 @@ struct TernaryExpr : Expr
 
 struct BinaryExpr : Expr
 {
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::string op;
+    Expr *left = nullptr;
+    Expr *right = nullptr;
+    BinaryOperator op;
+    OperandType operands = OPERANDS_UNKNOWN;
 
-    BinaryExpr(Expr *left, Expr *right, std::string op) : left(left), right(right), op(op) {}
-    BinaryExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, std::string op) : left(std::move(left)), right(std::move(right)), op(op) {}
+    BinaryExpr(Expr *left, Expr *right, BinaryOperator op) : left(left), right(right), op(op) {}
 
     void accept(Visitor *v) override
     {
@@ -204,11 +198,10 @@ struct BinaryExpr : Expr
 
 struct UnaryExpr : Expr
 {
-    std::unique_ptr<Expr> expr;
-    std::string op;
+    Expr *expr = nullptr;
+    UnaryOperator op;
 
-    UnaryExpr(Expr *expr, std::string op) : expr(expr), op(op) {}
-    UnaryExpr(std::unique_ptr<Expr> expr, std::string op) : expr(std::move(expr)), op(op) {}
+    UnaryExpr(Expr *expr, UnaryOperator op) : expr(expr), op(op) {}
 
     void accept(Visitor *v) override
     {
@@ -218,17 +211,14 @@ struct UnaryExpr : Expr
 
 struct CallExpr : Expr
 {
-    std::string identifier;
-    std::vector<std::unique_ptr<Expr>> args;
+    const std::string &identifier;
+    int depth = -1;
+    int slot = -1;
+    const Native *native = nullptr; // set by the Resolver when the call is to a builtin
+    int site = -1;                  // the Interpreter's inline cache for this call, numbered per Program
+    NodeList<Expr> args;
 
-    CallExpr(std::string identifier, std::vector<Expr *> args) : identifier(identifier)
-    {
-        for (auto &arg : args)
-        {
-            this->args.push_back(std::unique_ptr<Expr>(arg));
-        }
-    }
-    CallExpr(std::string identifier, std::vector<std::unique_ptr<Expr>> args) : identifier(identifier), args(std::move(args)) {}
+    CallExpr(String *identifier, NodeList<Expr> args) : identifier(identifier->chars), args(args) {}
 
     void accept(Visitor *v) override
     {
@@ -238,11 +228,12 @@ struct CallExpr : Expr
 
 struct ArrayAccessExpr : Expr
 {
-    std::string identifier;
-    std::unique_ptr<Expr> index;
+    const std::string &identifier;
+    int depth = -1;
+    int slot = -1;
+    Expr *index = nullptr;
 
-    ArrayAccessExpr(std::string identifier, Expr *index) : identifier(identifier), index(index) {}
-    ArrayAccessExpr(std::string identifier, std::unique_ptr<Expr> index) : identifier(identifier), index(std::move(index)) {}
+    ArrayAccessExpr(String *identifier, Expr *index) : identifier(identifier->chars), index(index) {}
 
     void accept(Visitor *v) override
     {
@@ -252,16 +243,9 @@ struct ArrayAccessExpr : Expr
 
 struct ArrayLiteral : Expr
 {
-    std::vector<std::unique_ptr<Expr>> elements;
+    NodeList<Expr> elements;
 
-    ArrayLiteral(std::vector<Expr *> elements)
-    {
-        for (auto &element : elements)
-        {
-            this->elements.push_back(std::unique_ptr<Expr>(element));
-        }
-    }
-    ArrayLiteral(std::vector<std::unique_ptr<Expr>> elements) : elements(std::move(elements)) {}
+    ArrayLiteral(NodeList<Expr> elements) : elements(elements) {}
 
     void accept(Visitor *v) override
     {
@@ -295,9 +279,9 @@ struct FloatLiteral : Expr
 
 struct StringLiteral : Expr
 {
-    std::string value;
+    String *value; // interned by the lexer
 
-    StringLiteral(std::string value) : value(value) {}
+    StringLiteral(String *value) : value(value) {}
 
     void accept(Visitor *v) override
     {
@@ -329,9 +313,12 @@ struct BoolLiteral : Expr
 
 struct IdentifierExpr : Expr
 {
-    std::string identifier;
+    const std::string &identifier;
+    // filled in by the Resolver: how many scopes up the variable lives and its index there
+    int depth = -1;
+    int slot = -1;
 
-    IdentifierExpr(std::string identifier) : identifier(identifier) {}
+    IdentifierExpr(String *identifier) : identifier(identifier->chars) {}
 
     void accept(Visitor *v) override
     {
@@ -348,11 +335,10 @@ struct Stmt : ASTNode
 
 struct IfStmt : Stmt
 {
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<BlockStmt> then_block;
+    Expr *condition = nullptr;
+    BlockStmt *then_block = nullptr;
 
     IfStmt(Expr *condition, Stmt *then_block) : condition(condition), then_block((BlockStmt *)then_block) {}
-    IfStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> then_block) : condition(std::move(condition)), then_block(std::move(then_block)) {}
 
     void accept(Visitor *v) override
     {
@@ -362,13 +348,12 @@ struct IfStmt : Stmt
 
 struct IfElseStmt : Stmt
 {
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<BlockStmt> then_block;
-    std::unique_ptr<BlockStmt> else_block;
+    Expr *condition = nullptr;
+    BlockStmt *then_block = nullptr;
+    BlockStmt *else_block = nullptr;
 
     // TODO: should be a block stmt
     IfElseStmt(Expr *condition, Stmt *then_block, Stmt *else_block) : condition(condition), then_block((BlockStmt *)then_block), else_block((BlockStmt *)else_block) {}
-    IfElseStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> then_block, std::unique_ptr<BlockStmt> else_block) : condition(std::move(condition)), then_block(std::move(then_block)), else_block(std::move(else_block)) {}
 
     void accept(Visitor *v) override
     {
@@ -378,12 +363,11 @@ struct IfElseStmt : Stmt
 
 struct WhileStmt : Stmt
 {
-    std::unique_ptr<Expr> condition;
-    std::unique_ptr<BlockStmt> block;
+    Expr *condition = nullptr;
+    BlockStmt *block = nullptr;
 
     // TODO: should be a block stmt
     WhileStmt(Expr *condition, Stmt *block) : condition(condition), block((BlockStmt *)block) {}
-    WhileStmt(std::unique_ptr<Expr> condition, std::unique_ptr<BlockStmt> block) : condition(std::move(condition)), block(std::move(block)) {}
 
     void accept(Visitor *v) override
     {
@@ -393,13 +377,13 @@ struct WhileStmt : Stmt
 
 struct ForInStmt : Stmt
 {
-    std::string identifier;
-    std::unique_ptr<Expr> iterable;
-    std::unique_ptr<BlockStmt> block;
+    const std::string &identifier;
+    int slot = -1;
+    Expr *iterable = nullptr;
+    BlockStmt *block = nullptr;
 
     // TODO: should be a block stmt
-    ForInStmt(std::string identifier, Expr *iterable, Stmt *block) : identifier(identifier), iterable(iterable), block((BlockStmt *)block) {}
-    ForInStmt(std::string idntifier, std::unique_ptr<Expr> iterable, std::unique_ptr<BlockStmt> block) : identifier(idntifier), iterable(std::move(iterable)), block(std::move(block)) {}
+    ForInStmt(String *identifier, Expr *iterable, Stmt *block) : identifier(identifier->chars), iterable(iterable), block((BlockStmt *)block) {}
 
     void accept(Visitor *v) override
     {
@@ -409,11 +393,11 @@ struct ForInStmt : Stmt
 
 struct ReturnStmt : Stmt
 {
-    std::unique_ptr<Expr> expr;
+    Expr *expr = nullptr;
     bool is_void = false;
+    bool tail_call = false; // set by the Resolver when expr is a call the function can be replaced by
 
     ReturnStmt(Expr *expr) : expr(expr) {}
-    ReturnStmt(std::unique_ptr<Expr> expr) : expr(std::move(expr)) {}
     ReturnStmt() : is_void(true) {}
 
     void accept(Visitor *v) override
@@ -444,20 +428,13 @@ struct ContinueStmt : Stmt
 
 struct FnDecl : Stmt
 {
-    std::string identifier;
-    std::vector<std::unique_ptr<IdentifierType>> params;
-    std::unique_ptr<Type> return_type;
-    std::unique_ptr<BlockStmt> block;
+    const std::string &identifier;
+    int slot = -1;
+    NodeList<IdentifierType> params;
+    Type *return_type = nullptr;
+    BlockStmt *block = nullptr;
 
-    FnDecl(std::string identifier, std::vector<IdentifierType *> params, Type *return_type, BlockStmt *block) : identifier(identifier), return_type(return_type), block(block)
-    {
-        for (auto &param : params)
-        {
-            this->params.push_back(std::unique_ptr<IdentifierType>(param));
-        }
-    }
-    FnDecl(std::string identifier, std::vector<std::unique_ptr<IdentifierType>> params, std::unique_ptr<Type> return_type, std::unique_ptr<BlockStmt> block) : identifier(identifier), params(std::move(params)), return_type(std::move(return_type)), block(std::move(block)) {}
-    FnDecl(std::string identifier, std::vector<std::unique_ptr<IdentifierType>> params, Type *return_type, BlockStmt *block) : identifier(identifier), return_type(return_type), block(block), params(std::move(params)) {}
+    FnDecl(String *identifier, NodeList<IdentifierType> params, Type *return_type, BlockStmt *block) : identifier(identifier->chars), params(params), return_type(return_type), block(block) {}
 
     void accept(Visitor *v) override
     {
@@ -467,12 +444,12 @@ struct FnDecl : Stmt
 
 struct VarDecl : Stmt
 {
-    std::string identifier;
-    std::unique_ptr<Type> type;
-    std::unique_ptr<Expr> value;
+    const std::string &identifier;
+    int slot = -1;
+    Type *type = nullptr;
+    Expr *value = nullptr;
 
-    VarDecl(std::string identifier, Type *type, Expr *value) : identifier(identifier), type(type), value(value) {}
-    VarDecl(std::string identifier, std::unique_ptr<Type> type, std::unique_ptr<Expr> value) : identifier(identifier), type(std::move(type)), value(std::move(value)) {}
+    VarDecl(String *identifier, Type *type, Expr *value) : identifier(identifier->chars), type(type), value(value) {}
 
     void accept(Visitor *v) override
     {
@@ -482,10 +459,9 @@ struct VarDecl : Stmt
 
 struct ExprStmt : Stmt
 {
-    std::unique_ptr<Expr> expr;
+    Expr *expr = nullptr;
 
     ExprStmt(Expr *expr) : expr(expr) {}
-    ExprStmt(std::unique_ptr<Expr> expr) : expr(std::move(expr)) {}
 
     void accept(Visitor *v) override
     {
@@ -495,16 +471,9 @@ struct ExprStmt : Stmt
 
 struct BlockStmt : Stmt
 {
-    std::vector<std::unique_ptr<Stmt>> stmts;
+    NodeList<Stmt> stmts;
 
-    BlockStmt(std::vector<Stmt *> stmts)
-    {
-        for (auto &stmt : stmts)
-        {
-            this->stmts.push_back(std::unique_ptr<Stmt>(stmt));
-        }
-    }
-    BlockStmt(std::vector<std::unique_ptr<Stmt>> stmts) : stmts(std::move(stmts)) {}
+    BlockStmt(NodeList<Stmt> stmts) : stmts(stmts) {}
 
     void accept(Visitor *v) override
     {
@@ -513,63 +482,57 @@ struct BlockStmt : Stmt
 };
 
 // type nodes
+enum TypeKind
+{
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_STRING,
+    TYPE_BOOL,
+    TYPE_VOID,
+    TYPE_NONE,
+    TYPE_ARRAY,
+    TYPE_FUNCTION,
+};
+
 struct Type
 {
+    TypeKind kind;
+
+    Type(TypeKind kind) : kind(kind) {}
 };
 
 struct PrimitiveType : Type
 {
-    std::string primitive;
-
-    PrimitiveType(std::string primitive) : primitive(primitive) {}
+    PrimitiveType(TypeKind kind) : Type(kind) {}
 };
 
 struct ArrayType : Type
 {
-    std::unique_ptr<Type> type;
+    Type *type = nullptr; // nullptr for the elements of an empty array literal
 
-    ArrayType(Type *type) : type(type) {}
-    ArrayType(std::unique_ptr<Type> type) : type(std::move(type)) {}
+    ArrayType(Type *type) : Type(TYPE_ARRAY), type(type) {}
 };
 
 struct FunctionType : Type
 {
-    std::vector<std::unique_ptr<Type>> params;
-    std::unique_ptr<Type> return_type;
+    NodeList<Type> params; // last to first, like every other list
+    Type *return_type = nullptr;
 
-    FunctionType(std::vector<Type *> params, Type *return_type)
-    {
-        for (auto &param : params)
-        {
-            this->params.push_back(std::unique_ptr<Type>(param));
-        }
-        this->return_type = std::unique_ptr<Type>(return_type);
-    }
-    FunctionType(std::vector<std::unique_ptr<Type>> params, Type *return_type) : params(std::move(params))
-    {
-        this->return_type = std::unique_ptr<Type>(return_type);
-    }
+    FunctionType(NodeList<Type> params, Type *return_type) : Type(TYPE_FUNCTION), params(params), return_type(return_type) {}
 };
 
 // tree nodes
 struct TreeNode : ASTNode
 {
-    std::vector<std::unique_ptr<TreeNode>> children;
+    NodeList<TreeNode> children;
     virtual void accept(Visitor *v) = 0;
     virtual ~TreeNode() {}
 };
 
 struct AndNode : TreeNode
 {
-    std::vector<std::unique_ptr<TreeNode>> children = {};
-    AndNode(std::vector<TreeNode *> children)
-    {
-        for (auto &child : children)
-        {
-            this->children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    AndNode(std::vector<std::unique_ptr<TreeNode>> children) : children(std::move(children)) {}
+    NodeList<TreeNode> children;
+    AndNode(NodeList<TreeNode> children) : children(children) {}
     AndNode() {}
 
     void accept(Visitor *v) override
@@ -580,15 +543,8 @@ struct AndNode : TreeNode
 
 struct OrNode : TreeNode
 {
-    std::vector<std::unique_ptr<TreeNode>> children = {};
-    OrNode(std::vector<TreeNode *> children)
-    {
-        for (auto &child : children)
-        {
-            this->children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    OrNode(std::vector<std::unique_ptr<TreeNode>> children) : children(std::move(children)) {}
+    NodeList<TreeNode> children;
+    OrNode(NodeList<TreeNode> children) : children(children) {}
     OrNode() {}
 
     void accept(Visitor *v) override
@@ -599,16 +555,9 @@ struct OrNode : TreeNode
 
 struct ThenNode : TreeNode
 {
-    std::vector<std::unique_ptr<TreeNode>> children = {};
+    NodeList<TreeNode> children;
 
-    ThenNode(std::vector<TreeNode *> children)
-    {
-        for (auto &child : children)
-        {
-            this->children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    ThenNode(std::vector<std::unique_ptr<TreeNode>> children) : children(std::move(children)) {}
+    ThenNode(NodeList<TreeNode> children) : children(children) {}
     ThenNode() {}
 
     void accept(Visitor *v) override
@@ -619,17 +568,10 @@ struct ThenNode : TreeNode
 
 struct BehaviorNode : TreeNode
 {
-    std::string identifier;
-    std::vector<std::unique_ptr<Expr>> args;
+    const std::string &identifier;
+    NodeList<Expr> args;
 
-    BehaviorNode(std::string identifier, std::vector<Expr *> args) : identifier(identifier)
-    {
-        for (auto &arg : args)
-        {
-            this->args.push_back(std::unique_ptr<Expr>(arg));
-        }
-    }
-    BehaviorNode(std::string identifier, std::vector<std::unique_ptr<Expr>> args) : identifier(identifier), args(std::move(args)) {}
+    BehaviorNode(String *identifier, NodeList<Expr> args) : identifier(identifier->chars), args(args) {}
 
     void accept(Visitor *v) override
     {
@@ -645,9 +587,9 @@ struct PseudoNode : TreeNode
 
 struct AtLoadNode : PseudoNode
 {
-    std::vector<std::unique_ptr<Expr>> args;
+    NodeList<Expr> args;
 
-    AtLoadNode(std::vector<std::unique_ptr<Expr>> args) : args(std::move(args)) {}
+    AtLoadNode(NodeList<Expr> args) : args(args) {}
 
     void accept(Visitor *v) override
     {
@@ -657,19 +599,11 @@ struct AtLoadNode : PseudoNode
 
 struct AtIfNode : PseudoNode
 {
-    std::unique_ptr<Expr> condition;
-    std::vector<std::unique_ptr<TreeNode>> children;
+    Expr *condition = nullptr;
+    NodeList<TreeNode> children;
 
-    AtIfNode(Expr *condition, std::vector<TreeNode *> children) : condition(condition)
-    {
-        for (auto &child : children)
-        {
-            this->children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    AtIfNode(std::unique_ptr<Expr> condition, std::vector<std::unique_ptr<TreeNode>> children) : condition(std::move(condition)), children(std::move(children)) {}
+    AtIfNode(Expr *condition, NodeList<TreeNode> children) : condition(condition), children(children) {}
 
-    AtIfNode(Expr *condition, std::vector<std::unique_ptr<TreeNode>> children) : condition(condition), children(std::move(children)) {}
 
     void accept(Visitor *v) override
     {
@@ -679,23 +613,11 @@ struct AtIfNode : PseudoNode
 
 struct AtIfElseNode : PseudoNode
 {
-    std::unique_ptr<Expr> condition;
-    std::vector<std::unique_ptr<TreeNode>> then_children;
-    std::vector<std::unique_ptr<TreeNode>> else_children;
+    Expr *condition = nullptr;
+    NodeList<TreeNode> then_children;
+    NodeList<TreeNode> else_children;
 
-    AtIfElseNode(Expr *condition, std::vector<TreeNode *> then_children, std::vector<TreeNode *> else_children) : condition(condition)
-    {
-        for (auto &child : then_children)
-        {
-            this->then_children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-        for (auto &child : else_children)
-        {
-            this->else_children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    AtIfElseNode(std::unique_ptr<Expr> condition, std::vector<std::unique_ptr<TreeNode>> then_children, std::vector<std::unique_ptr<TreeNode>> else_children) : condition(std::move(condition)), then_children(std::move(then_children)), else_children(std::move(else_children)) {}
-    AtIfElseNode(Expr *condition, std::vector<std::unique_ptr<TreeNode>> then_children, std::vector<std::unique_ptr<TreeNode>> else_children) : condition(condition), then_children(std::move(then_children)), else_children(std::move(else_children)) {}
+    AtIfElseNode(Expr *condition, NodeList<TreeNode> then_children, NodeList<TreeNode> else_children) : condition(condition), then_children(then_children), else_children(else_children) {}
 
     void accept(Visitor *v) override
     {
@@ -705,19 +627,12 @@ struct AtIfElseNode : PseudoNode
 
 struct AtForNode : PseudoNode
 {
-    std::string identifier;
-    std::unique_ptr<Expr> iterable;
-    std::vector<std::unique_ptr<TreeNode>> children;
+    const std::string &identifier;
+    int slot = -1;
+    Expr *iterable = nullptr;
+    NodeList<TreeNode> children;
 
-    AtForNode(std::string identifier, Expr *iterable, std::vector<TreeNode *> children) : identifier(identifier), iterable(iterable)
-    {
-        for (auto &child : children)
-        {
-            this->children.push_back(std::unique_ptr<TreeNode>(child));
-        }
-    }
-    AtForNode(std::string identifier, std::unique_ptr<Expr> iterable, std::vector<std::unique_ptr<TreeNode>> children) : identifier(identifier), iterable(std::move(iterable)), children(std::move(children)) {}
-    AtForNode(std::string identifier, Expr *iterable, std::vector<std::unique_ptr<TreeNode>> children) : identifier(identifier), iterable(iterable), children(std::move(children)) {}
+    AtForNode(String *identifier, Expr *iterable, NodeList<TreeNode> children) : identifier(identifier->chars), iterable(iterable), children(children) {}
 
     void accept(Visitor *v) override
     {
@@ -727,34 +642,10 @@ struct AtForNode : PseudoNode
 
 // helper structs
 
-template <typename T>
-struct List
-{
-    std::vector<std::unique_ptr<T>> items = {};
-
-    List(std::vector<T *> items)
-    {
-        for (auto &item : items)
-        {
-            this->items.push_back(std::unique_ptr<T>(item));
-        }
-    }
-
-    List(std::vector<std::unique_ptr<T>> items) : items(std::move(items)) {}
-
-    List() {}
-
-    void add(T *item)
-    {
-        items.push_back(std::unique_ptr<T>(item));
-    }
-};
-
 struct IdentifierType
 {
-    std::string identifier;
-    std::unique_ptr<Type> type;
+    const std::string &identifier;
+    Type *type = nullptr;
 
-    IdentifierType(std::string identifier, Type *type) : identifier(identifier), type(type) {}
-    IdentifierType(std::string identifier, std::unique_ptr<Type> type) : identifier(identifier), type(std::move(type)) {}
+    IdentifierType(String *identifier, Type *type) : identifier(identifier->chars), type(type) {}
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+// decoded once by the parser so evaluation never compares operator strings.
+// the order matches the rows of the dispatch tables in value/value.hpp
+enum BinaryOperator
+{
+    BINARY_ADD,
+    BINARY_SUB,
+    BINARY_MUL,
+    BINARY_DIV,
+    BINARY_MOD,
+    BINARY_POW,
+    BINARY_EQ,
+    BINARY_NE,
+    BINARY_LT,
+    BINARY_LE,
+    BINARY_GT,
+    BINARY_GE,
+    BINARY_AND,
+    BINARY_OR,
+    BINARY_OPERATOR_COUNT,
+};
+
+enum UnaryOperator
+{
+    UNARY_NEG,
+    UNARY_NOT,
+    UNARY_OPERATOR_COUNT,
+};
+
+// what the TypeChecker proved about both operands of a BinaryExpr. a proven pair lets the
+// evaluator skip the tag checks
+enum OperandType
+{
+    OPERANDS_UNKNOWN,
+    OPERANDS_INT,
+    OPERANDS_FLOAT,
+};
+
+// used in type errors, e.g. "Invalid types for addition"
+inline const char *operator_description(BinaryOperator op)
+{
+    static const char *descriptions[] = {
+        "addition", "subtraction", "multiplication", "division", "modulo", "exponentiation", "equality",
+        "inequality", "less than", "less than or equal", "greater than", "greater than or equal",
+        "logical and", "logical or"};
+    return descriptions[op];
+}
+
+inline const char *operator_description(UnaryOperator op)
+{
+    static const char *descriptions[] = {"negation", "logical not"};
+    return descriptions[op];
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+// roslang --batch <inputs.jsonl> <program>: evaluates the program once for every line of inputs,
+// each line binding its inputs the way a --serve request does. the program is parsed once, the
+// lines are spread over worker threads, and the output of each line, what it printed and then
+// its tree, is written to out in the order of the lines. a line that fails is written up to its
+// error, which is printed after it and ends the batch with 1. workers is --jobs, 0 for every core
+int run_batch(const char *inputs_path, const char *program_path, const std::string &emit, bool interpret, int workers, std::ostream &out);
@@ -1,64 +1,146 @@
 #pragma once
+#include <cstdint>
+#include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace DHTT
 {
-    struct Node
+    enum Kind : uint8_t
     {
-        virtual ~Node() = default;
-        std::vector<std::shared_ptr<Node>> children;
+        AND,
+        OR,
+        THEN,
+        BEHAVIOR, // always a leaf node
+        PSEUDO,   // for use in tree building, only kept when it is a root
+    };
+
+    typedef uint32_t NodeId;
+
+    inline const char *kind_name(Kind kind)
+    {
+        static const char *names[] = {"AND", "OR", "THEN", "BEHAVIOR", "PSEUDO"};
+        return names[kind];
+    }
+
+    struct Sink;
+
+    // the output tree, as a struct of arrays. nodes are numbered in the order they are closed,
+    // so every node comes after its children, and its children and strings are one range each:
+    //   children of n: child_ids[first_child[n], first_child[n + 1])
+    //   strings of n:  first_string[n], up to first_string[n + 1] (a behavior's identifier, then its args)
+    //   string s:      text[string_start[s], string_start[s + 1])
+    // the builder keeps the children of every open node on one stack, so closing a pseudo node
+    // leaves its children where they are for the parent to take.
+    //
+    // with a sink attached the tree streams: each finished child of the open root, and each
+    // finished root, goes to the sink and the arrays are emptied, so they only ever hold one
+    // subtree of the root
+    struct Tree
+    {
+        std::vector<Kind> kinds;
+        std::vector<uint32_t> first_child{0};
+        std::vector<uint32_t> first_string{0};
+        std::vector<NodeId> child_ids;
+        std::vector<uint32_t> string_start{0};
+        std::string text;
+
+        std::vector<NodeId> roots;
+
+        // building
+        struct Open
+        {
+            Kind kind;
+            size_t mark; // where its children start in pending
+        };
+        std::vector<Open> open_nodes;
+        std::vector<NodeId> pending;
+
+        Sink *sink = nullptr;
+        int nested = 0; // open nodes under the root that aren't pseudo
 
-        void add(std::shared_ptr<Node> child)
+        size_t size() const
         {
-            children.push_back(std::move(child));
+            return kinds.size();
         }
 
-        virtual void sayName() = 0;
-    };
+        const NodeId *children_begin(NodeId node) const
+        {
+            return child_ids.data() + first_child[node];
+        }
 
-    struct And : Node
-    {
-        void sayName() override
+        const NodeId *children_end(NodeId node) const
         {
-            std::cout << "AND" << std::endl;
+            return child_ids.data() + first_child[node + 1];
         }
-    };
 
-    struct Or : Node
-    {
-        void sayName() override
+        size_t string_count(NodeId node) const
         {
-            std::cout << "OR" << std::endl;
+            return first_string[node + 1] - first_string[node];
         }
-    };
 
-    struct Then : Node
-    {
-        void sayName() override
+        // the i-th string of node, in place
+        const char *string(NodeId node, size_t i, size_t &length) const
         {
-            std::cout << "THEN" << std::endl;
+            auto s = first_string[node] + i;
+            length = string_start[s + 1] - string_start[s];
+            return text.data() + string_start[s];
         }
-    };
 
-    struct Behavior : Node // always a leaf node
-    {
-        std::string identifier;
-        std::vector<std::string> args;
+        std::string string(NodeId node, size_t i) const
+        {
+            size_t length;
+            auto chars = string(node, i, length);
+            return std::string(chars, length);
+        }
+
+        std::string identifier(NodeId node) const
+        {
+            return string(node, 0);
+        }
+
+        void open(Kind kind);
 
-        Behavior(std::string identifier, std::vector<std::string> args) : identifier(identifier), args(args) {}
+        // a pseudo node inside another node adds nothing: its children are already in place
+        void close();
 
-        void sayName() override
+        // a behavior's identifier, then each of its args, then end_behavior
+        void add_string(const std::string &chars)
         {
-            std::cout << "BEHAVIOR: " << identifier << std::endl;
+            text += chars;
+            string_start.push_back(text.size());
         }
-    };
 
-    struct Pseudo : Node // for use in tree building
-    {
-        void sayName() override
+        void end_behavior()
         {
-            std::cout << "PSEUDO" << std::endl;
+            add(make(BEHAVIOR, pending.size()));
         }
+
+        // copies the roots of a tree built elsewhere, e.g. by a @load, into this one. a copied
+        // pseudo root is unwrapped when it lands inside another node
+        void splice(const Tree &other);
+
+        void say_name(NodeId node, std::ostream &out) const
+        {
+            out << kind_name(kinds[node]);
+            if (kinds[node] == BEHAVIOR)
+            {
+                size_t length;
+                auto chars = string(node, 0, length);
+                out << ": ";
+                out.write(chars, length);
+            }
+            out << '\n';
+        }
+
+    private:
+        // a node of kind whose children are pending[mark, end)
+        NodeId make(Kind kind, size_t mark);
+
+        void add(NodeId node);
+
+        // drops every node, once the sink has them
+        void clear();
     };
-};
\ No newline at end of file
+};
@@ -0,0 +1,230 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the file written by roslang --emit=bin, and a reader that maps it and walks the tree in place.
+// this header only needs the standard library and POSIX, so consumers can copy it as is.
+//
+// layout, in host byte order, every section starting on a 4 byte boundary:
+//   BinaryHeader
+//   uint32 first_child[node_count + 1]   children of n: child_ids[first_child[n], first_child[n + 1])
+//   uint32 first_string[node_count + 1]  strings of n: first_string[n] up to first_string[n + 1]
+//   uint32 child_ids[child_count]
+//   uint32 string_start[string_count + 1] string s: text[string_start[s], string_start[s + 1])
+//   uint32 roots[root_count]
+//   uint8  kinds[node_count]             0 AND, 1 OR, 2 THEN, 3 BEHAVIOR, 4 PSEUDO
+//   char   text[text_size]
+// a behavior's first string is its identifier and the rest are its args. nodes are numbered
+// children first, so a node's children always have smaller ids than it does
+namespace DHTT
+{
+    static const char BINARY_MAGIC[4] = {'D', 'H', 'T', 'T'};
+    static const uint32_t BINARY_VERSION = 1;
+
+    struct BinaryHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t node_count;
+        uint32_t child_count;
+        uint32_t string_count;
+        uint32_t root_count;
+        uint32_t text_size;
+        uint32_t reserved;
+    };
+
+    struct BinaryReader
+    {
+        const char *data = nullptr;
+        size_t size = 0;
+
+        const BinaryHeader *header = nullptr;
+        const uint32_t *first_child = nullptr;
+        const uint32_t *first_string = nullptr;
+        const uint32_t *child_ids = nullptr;
+        const uint32_t *string_start = nullptr;
+        const uint32_t *roots = nullptr;
+        const uint8_t *kinds = nullptr;
+        const char *text = nullptr;
+
+        BinaryReader() {}
+        BinaryReader(const BinaryReader &) = delete;
+        BinaryReader &operator=(const BinaryReader &) = delete;
+
+        ~BinaryReader()
+        {
+            if (data != nullptr)
+            {
+                munmap((void *)data, size);
+            }
+        }
+
+        // false when the file can't be mapped, or isn't a well formed tree of this version
+        bool open(const char *path)
+        {
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinaryHeader))
+            {
+                close(fd);
+                return false;
+            }
+
+            void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                return false;
+            }
+
+            data = (const char *)mapping;
+            size = st.st_size;
+            return attach();
+        }
+
+        uint32_t node_count() const
+        {
+            return header->node_count;
+        }
+
+        uint32_t root_count() const
+        {
+            return header->root_count;
+        }
+
+        uint8_t kind(uint32_t node) const
+        {
+            return kinds[node];
+        }
+
+        const uint32_t *children_begin(uint32_t node) const
+        {
+            return child_ids + first_child[node];
+        }
+
+        const uint32_t *children_end(uint32_t node) const
+        {
+            return child_ids + first_child[node + 1];
+        }
+
+        uint32_t string_count(uint32_t node) const
+        {
+            return first_string[node + 1] - first_string[node];
+        }
+
+        // the i-th string of node, not NUL terminated
+        const char *string(uint32_t node, uint32_t i, size_t &length) const
+        {
+            auto s = first_string[node] + i;
+            length = string_start[s + 1] - string_start[s];
+            return text + string_start[s];
+        }
+
+        std::string string(uint32_t node, uint32_t i) const
+        {
+            size_t length;
+            auto chars = string(node, i, length);
+            return std::string(chars, length);
+        }
+
+    private:
+        static size_t aligned(size_t offset)
+        {
+            return (offset + 3) & ~(size_t)3;
+        }
+
+        // offsets[0, count] start at 0, never go down, and end at most at limit
+        static bool offsets_valid(const uint32_t *offsets, size_t count, uint32_t limit)
+        {
+            if (offsets[0] != 0)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if (offsets[i + 1] < offsets[i])
+                {
+                    return false;
+                }
+            }
+            return offsets[count] <= limit;
+        }
+
+        // points every section into the mapping, checking each one fits, then checks every offset
+        // and id, so walking the tree can't read outside it or loop
+        bool attach()
+        {
+            header = (const BinaryHeader *)data;
+            if (memcmp(header->magic, BINARY_MAGIC, 4) != 0 || header->version != BINARY_VERSION)
+            {
+                return false;
+            }
+
+            // sizes are worked out in size_t, so counts near 2^32 can't wrap
+            size_t offset = sizeof(BinaryHeader);
+            auto section = [&](size_t count, size_t width) -> const char *
+            {
+                offset = aligned(offset);
+                if (offset > size || count > (size - offset) / width)
+                {
+                    return nullptr;
+                }
+                auto start = data + offset;
+                offset += count * width;
+                return start;
+            };
+
+            size_t nodes = header->node_count;
+            first_child = (const uint32_t *)section(nodes + 1, 4);
+            first_string = (const uint32_t *)section(nodes + 1, 4);
+            child_ids = (const uint32_t *)section(header->child_count, 4);
+            string_start = (const uint32_t *)section((size_t)header->string_count + 1, 4);
+            roots = (const uint32_t *)section(header->root_count, 4);
+            kinds = (const uint8_t *)section(nodes, 1);
+            text = section(header->text_size, 1);
+            if (first_child == nullptr || first_string == nullptr || child_ids == nullptr ||
+                string_start == nullptr || roots == nullptr || kinds == nullptr || text == nullptr)
+            {
+                return false;
+            }
+
+            if (!offsets_valid(first_child, nodes, header->child_count) ||
+                !offsets_valid(first_string, nodes, header->string_count) ||
+                !offsets_valid(string_start, header->string_count, header->text_size))
+            {
+                return false;
+            }
+
+            // children come before their parent, which also rules out cycles
+            for (size_t node = 0; node < nodes; node++)
+            {
+                for (auto child = children_begin(node); child != children_end(node); child++)
+                {
+                    if (*child >= node)
+                    {
+                        return false;
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < header->root_count; i++)
+            {
+                if (roots[i] >= nodes)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+};
@@ -1,58 +1,75 @@
 #pragma once
+#include <memory>
+#include <vector>
 
+// variables are addressed by the (depth, slot) pairs computed by the Resolver
 template <typename T>
 struct Environment
 {
-    std::vector<std::unordered_map<std::string, T>> env;
+    struct Frame
+    {
+        std::vector<T> slots;
+        std::shared_ptr<Frame> parent;
+
+        Frame(std::shared_ptr<Frame> parent) : parent(std::move(parent)) {}
+    };
+
+    std::shared_ptr<Frame> frame;
 
     void push_env()
     {
-        env.push_back(std::unordered_map<std::string, T>());
+        frame = std::make_shared<Frame>(frame);
     }
 
     void pop_env()
     {
-        env.pop_back();
+        frame = frame->parent;
     }
 
-    void set(std::string key, T value)
+    Frame *ancestor(int depth)
     {
-        for (auto it = env.rbegin(); it != env.rend(); ++it)
+        auto current = frame.get();
+        for (int i = 0; i < depth; i++)
         {
-            if (it->find(key) != it->end())
-            {
-                it->at(key) = value;
-                return;
-            }
+            current = current->parent.get();
         }
+        return current;
+    }
 
-        env.back()[key] = value;
+    void define(int slot, T value)
+    {
+        auto &slots = frame->slots;
+        if (slot >= slots.size())
+        {
+            slots.resize(slot + 1);
+        }
+        slots[slot] = value;
     }
 
-    bool contains(std::string key)
+    void set(int depth, int slot, T value)
     {
-        for (auto it = env.rbegin(); it != env.rend(); ++it)
+        auto &slots = ancestor(depth)->slots;
+        if (slot >= slots.size())
         {
-            if (it->find(key) != it->end())
-            {
-                return true;
-            }
+            slots.resize(slot + 1);
         }
+        slots[slot] = value;
+    }
 
-        return false;
+    // the variable itself rather than a copy, or nullptr if it was never defined
+    T *find(int depth, int slot)
+    {
+        auto &slots = ancestor(depth)->slots;
+        return slot < slots.size() ? &slots[slot] : nullptr;
     }
 
-    T get(std::string key)
+    T get(int depth, int slot)
     {
-        for (auto it = env.rbegin(); it != env.rend(); ++it)
+        auto &slots = ancestor(depth)->slots;
+        if (slot >= slots.size())
         {
-            auto value = it->find(key);
-            if (value != it->end())
-            {
-                return value->second;
-            }
+            return T();
         }
-
-        return T();
+        return slots[slot];
     }
 };
@@ -0,0 +1,29 @@
+#pragma once
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// ends the process after an error has been printed to error_output(). on the main thread this
+// is exit(1). another thread can't run the static destructors while the rest still use the
+// tables they free, so it flushes std::cerr and _exits instead. loads and --batch lines run
+// inside catch_errors, where it unwinds back to catch_errors instead of ending anything
+[[noreturn]] void error_exit();
+
+// where an error is printed before error_exit: std::cerr, or inside catch_errors the message
+// catch_errors returns
+std::ostream &error_output();
+
+// runs body, and returns the error that stopped it without its last newline, or "" when it
+// finished. a run of loads uses this to report the error of each load in order
+std::string catch_errors(const std::function<void()> &body);
+
+// how errors end on this thread. a thread that runs while the one that started it waits, like
+// the interpreter's deep stack, takes over the handling of that thread
+struct ErrorHandling
+{
+    bool exits;                 // error_exit can exit(1), as on the main thread
+    std::ostringstream *caught; // the message, inside catch_errors
+};
+ErrorHandling error_handling();
+void set_error_handling(const ErrorHandling &handling);
@@ -1,6 +0,0 @@
-#pragma once
-#include <exception>
-
-struct BreakException : std::exception
-{
-};
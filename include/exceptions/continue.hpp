@@ -1,6 +0,0 @@
-#pragma once
-#include <exception>
-
-struct ContinueException : std::exception
-{
-};
\ No newline at end of file
@@ -1,4 +0,0 @@
-#pragma once
-#include "break.hpp"
-#include "continue.hpp"
-#include "return.hpp"
@@ -1,6 +0,0 @@
-#pragma once
-#include <exception>
-
-struct ReturnException : std::exception
-{
-};
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "value/value.hpp"
+
+struct Program;
+
+// a parsed json document, for requests to --serve and the input lines of --batch
+struct Json
+{
+    enum Kind
+    {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_INT,
+        JSON_FLOAT,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    Kind kind = JSON_NULL;
+    bool boolean = false;
+    long long integer = 0;
+    double number = 0;
+    std::string string;
+    std::vector<Json> items;       // of an array, or the values of an object
+    std::vector<std::string> keys; // of an object, one per item
+
+    // the member named key of an object, or nullptr
+    const Json *get(const std::string &key) const;
+};
+
+// parses text, exiting with what it was if it isn't a single json value
+Json parse_json(const std::string &text, const char *what);
+
+// the inputs of program from a json array, in order, or a json object, by name. the inputs
+// left out, or null, fall back to their defaults. exits if a value has no roslang type: an
+// object, or an int out of range
+std::vector<Value> json_inputs(Program *program, const Json &inputs);
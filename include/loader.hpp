@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "dhtt.hpp"
+#include "value/value.hpp"
+
+struct Program;
+
+// -O level for every program loaded from now on, @load included. 0 skips the Optimizer
+void set_optimization_level(int level);
+
+// reads, parses, optimizes and resolves a .dhtt file, exiting if it cannot be opened or parsed.
+// the main program runs without arguments, so the defaults of its inputs are constants
+Program *load_program(std::string path, bool main_program = false);
+
+// hits and misses of the @load cache, reported by --load-stats
+struct LoadCacheStats
+{
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> trees_reused{0};
+
+    void report(std::ostream &out)
+    {
+        out << "load cache: " << hits << " hits, " << misses << " misses, "
+            << trees_reused << " trees reused" << std::endl;
+    }
+};
+
+LoadCacheStats &load_cache_stats();
+
+// load_program for @load. each file is parsed once per process and shared by every load
+// of it, until its mtime or size changes. callers keep the pointer while they evaluate it,
+// so a reparse never frees a program that is still running
+std::shared_ptr<Program> load_cached_program(std::string path);
+
+// a file load_cached_program parsed, as it was when it was read
+struct ParsedFile
+{
+    std::string path; // canonical
+    time_t mtime;
+    off_t size;
+    std::string text;
+};
+
+// called with each file load_cached_program parses. a --serve worker sends them to the daemon,
+// which caches them with cache_program for the requests after this one
+void set_parse_listener(void (*listener)(const ParsedFile &file));
+
+// parses text, which parsed once already so it can't fail, and caches it as file.path
+void cache_program(const ParsedFile &file);
+
+// a finished tree is never changed, so one can be shared by every load that reuses it
+typedef std::shared_ptr<const DHTT::Tree> LoadedTree;
+typedef LoadedTree (*LoadEvaluator)(Program *program, std::vector<Value> inputs);
+
+// loaded programs are deterministic, so the tree one builds only depends on its arguments.
+// --memoize-loads turns memoization on for every file, --memoize-load <file> for one file
+void memoize_all_loads();
+void memoize_loads_of(std::string path);
+
+// @load(path, inputs...): runs the cached program with evaluate, or reuses the tree of an
+// earlier load of the same file with equal inputs when the file is memoized, and prints again
+// what that load printed. the caller splices the nodes into its own tree
+LoadedTree load_tree(std::string path, std::vector<Value> inputs, LoadEvaluator evaluate);
+
+// --jobs N: how many threads a run of sibling @loads is spread over. 1 evaluates them in turn
+void set_load_jobs(int count);
+int load_jobs();
+
+// one @load in a run of sibling loads
+struct LoadJob
+{
+    std::string path;
+    std::vector<Value> inputs;
+    std::string before; // printed by the caller between the previous load of the run and this one
+    std::string output; // printed by the loaded program
+    std::string error;  // what stopped the load, reported by the caller's thread in order
+    LoadedTree tree;
+};
+
+// true when an input is an array or a function, which the loaded program can change or call
+// into the caller's state through. a load like that runs on the calling thread, and ends its run
+// so the loads after it see what it changed, the same as evaluating them in turn
+bool shares_state(const std::vector<Value> &inputs);
+
+// evaluates a run of sibling loads on the worker pool, then prints everything the run printed
+// in the order it would have been printed had the loads run one after another. loads that
+// share state run on this thread, after the others
+void run_loads(std::vector<LoadJob> &loads, LoadEvaluator evaluate);
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// the interpreter nests native frames for every call, so it runs on a stack that holds as many
+// calls as the VM allows by default. only the pages it touches are ever used
+const size_t DEEP_STACK_BYTES = (size_t)512 << 20;
+
+// runs body on this thread when it is already on a deep stack, else on a thread that is while
+// this one waits. body prints to the same StandardLib::output() and handles an error the way
+// this thread would. when no such thread can be started it runs here
+void on_deep_stack(const std::function<void()> &body);
+
+// true once this thread's stack is nearly full, so the interpreter can stop with an error
+// before it overflows
+bool native_stack_low();
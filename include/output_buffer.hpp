@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+// a large write buffer in front of a file descriptor. it only writes when it fills up, on
+// flush() and when it's destroyed, where std::cout goes through stdio and std::endl flushes
+// every line. writes bigger than the buffer skip it
+struct OutputBuffer : std::streambuf
+{
+    OutputBuffer(int fd, size_t size = 1 << 20);
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+    ~OutputBuffer();
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char *chars, std::streamsize count) override;
+    int sync() override; // other threads may flush it through std::cerr's tie
+
+private:
+    int fd;
+    std::vector<char> buffer;
+    std::mutex mutex;
+
+    bool drain();
+    bool write_all(const char *chars, size_t count);
+};
+
+// an ostream over an OutputBuffer, on stdout or a file it creates
+struct Output : std::ostream
+{
+    OutputBuffer buffer;
+    int fd;
+
+    Output(int fd);
+    ~Output();
+
+    // nullptr when the file can't be created
+    static Output *create(const char *path);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <utility>
+#include "ast_nodes/ast.hpp"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+// everything one call of ros_parse needs, shared by the scanner and the parser. nothing lives
+// in globals, so any number of threads can parse at once, and a parse that fails can't leave
+// indentation state behind for the next one
+struct ParseContext
+{
+    Arena *arena = nullptr;     // every node of the program being parsed is allocated here
+    Program *program = nullptr; // set once the whole file has been parsed
+
+    // scanner state
+    int current_line_indent = 0;
+    int indent_level = 0;
+
+    template <typename T, typename... Args>
+    T *node(Args &&...args)
+    {
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+};
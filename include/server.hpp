@@ -0,0 +1,18 @@
+#pragma once
+
+// roslang --serve <socket>: a daemon that keeps parsed programs, and the programs they @load,
+// from one request to the next. every file is reparsed once its mtime or size changes.
+//
+// a client connects to the unix socket at the path, or writes to stdin when the path is -,
+// and sends requests one per line:
+//   {"program": "mission.dhtt", "inputs": {"speed": 2} or [2], "emit": "text|json|yaml|bin"}
+// inputs and emit are optional. relative paths are relative to the daemon's directory. each
+// request is answered in order with
+//   ok <length>\n<the tree>         or
+//   error <length>\n<what the program printed, then the error>
+//
+// each request runs in a worker process forked from the daemon, so it starts with every cached
+// program and can exit on an error like a normal run would. requests on different connections
+// run at the same time. a worker sends the daemon the text of every file it had to parse, and
+// the daemon parses that too, so the workers after it start with the file
+int serve(const char *socket_path, bool interpret);
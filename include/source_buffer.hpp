@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// the bytes of a source file, laid out the way the scanner wants to scan them in place: the
+// text ends with a newline and is followed by the two NULs flex uses as its end of buffer
+// marker. regular files are mapped, so pages are only copied if the scanner writes to them;
+// pipes, and files the mapping can't end with the NULs, are read into memory in one pass
+struct SourceBuffer
+{
+    char *data = nullptr;
+    size_t size = 0;      // of the text, not counting the NULs
+    size_t mapped = 0;    // length of the mapping, 0 when data was read into the heap
+
+    SourceBuffer() {}
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+
+    // false when the file can't be opened or read
+    bool load(const std::string &path);
+
+    // a copy of text, for a file read earlier
+    void assign(const std::string &text);
+
+    // number of lines in the text
+    size_t lines() const;
+
+private:
+    bool map(int fd, size_t file_size);
+    bool read_all(int fd);
+};
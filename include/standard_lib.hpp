@@ -1,9 +1,66 @@
 #pragma once
+#include <ostream>
+#include <string>
 #include <vector>
 
 struct Value;
+typedef Value (*NativeFunction)(std::vector<Value> args);
+
+// what a builtin accepts in one argument position
+enum NativeParam
+{
+    PARAM_ANY,
+    PARAM_INT,
+    PARAM_NUMBER,   // int or float
+    PARAM_SCALAR,   // int, float, string or bool
+    PARAM_SEQUENCE, // string or array
+    PARAM_ARRAY,
+    PARAM_ELEMENT,  // the element type of the array before it
+    PARAM_SAME,     // the type of the argument before it
+};
+
+// what a builtin returns
+enum NativeResult
+{
+    RESULT_NONE,
+    RESULT_INT,
+    RESULT_FLOAT,
+    RESULT_STRING,
+    RESULT_INT_ARRAY,
+    RESULT_FIRST, // the type of the first argument
+};
+
+// a builtin function. the TypeChecker checks calls against the signature, and the Resolver
+// points each call at its entry, so evaluating one never looks the name up
+struct Native
+{
+    const char *name;
+    NativeFunction function;
+    int min_args;
+    int max_args;                    // -1 for any number
+    std::vector<NativeParam> params; // one per position, the last one repeats
+    NativeResult result;
+
+    bool takes(size_t argc) const
+    {
+        return argc >= (size_t)min_args && (max_args < 0 || argc <= (size_t)max_args);
+    }
+
+    NativeParam param(size_t i) const
+    {
+        return params[i < params.size() ? i : params.size() - 1];
+    }
+};
+
 namespace StandardLib
 {
-    void print(std::vector<Value> vals);
-    Value range(std::vector<Value> args);
-}
\ No newline at end of file
+    // where print writes on this thread. load workers point it at a buffer, so the output of
+    // concurrent loads can be written out in their serial order
+    std::ostream *&output();
+
+    // the builtin called name, or nullptr. a function the program defines shadows it
+    const Native *native(const std::string &name);
+
+    // every builtin, so the VM can refer to one by its index
+    const Native *natives();
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdio>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "dhtt.hpp"
+
+namespace DHTT
+{
+    // where the output tree goes. a tree with a sink attached (--stream) calls it while the
+    // tree is being built, otherwise emit() replays the finished tree through it
+    struct Sink
+    {
+        virtual ~Sink() {}
+
+        // the outermost node opened. its children follow through node(), then close_root
+        virtual void open_root(Kind kind) = 0;
+
+        // a finished child of the open root, or a whole root when none is open. the tree is
+        // only valid during the call
+        virtual void node(const Tree &tree, NodeId node) = 0;
+
+        virtual void close_root() = 0;
+
+        // after the last root
+        virtual void finish() {}
+    };
+
+    // sends every root of a finished tree through sink, then finishes it
+    void emit(const Tree &tree, Sink &sink);
+
+    // the sink for --emit=<format>: text, json, yaml or bin. nullptr for any other format
+    Sink *make_sink(const std::string &format, std::ostream &out);
+
+    // --emit=text: one node per line, children indented under their parent
+    struct TextSink : Sink
+    {
+        std::ostream &out;
+        bool in_root = false;
+        std::vector<std::pair<NodeId, int>> stack; // nodes still to write, and their depth
+
+        TextSink(std::ostream &out) : out(out) {}
+
+        void open_root(Kind kind) override;
+        void node(const Tree &tree, NodeId node) override;
+        void close_root() override;
+    };
+
+    // --emit=json: an array of roots, each {"kind", "children"} or {"kind", "identifier", "args"}
+    struct JsonSink : Sink
+    {
+        std::ostream &out;
+        bool in_root = false;
+        bool first = true; // no comma before the next root, or the next child of the open root
+
+        // the nodes whose children are being written, and the next child of each
+        struct Frame
+        {
+            NodeId node;
+            const NodeId *next;
+        };
+        std::vector<Frame> stack;
+
+        JsonSink(std::ostream &out) : out(out) {}
+
+        void open_root(Kind kind) override;
+        void node(const Tree &tree, NodeId node) override;
+        void close_root() override;
+        void finish() override;
+
+    private:
+        void separate();
+        void write(const Tree &tree, NodeId node);
+    };
+
+    // --emit=yaml: the same shape as json, as a block sequence of roots
+    struct YamlSink : Sink
+    {
+        std::ostream &out;
+        bool in_root = false;
+        bool first = true; // nothing written yet, or nothing under the open root
+        std::vector<std::pair<NodeId, int>> stack;
+
+        YamlSink(std::ostream &out) : out(out) {}
+
+        void open_root(Kind kind) override;
+        void node(const Tree &tree, NodeId node) override;
+        void close_root() override;
+        void finish() override;
+    };
+
+    // --emit=bin: the layout in dhtt_reader.hpp. its header comes first but holds the counts,
+    // so the sections are written to temporary files and copied out behind it at the end
+    struct BinarySink : Sink
+    {
+        enum Section
+        {
+            FIRST_CHILD,
+            FIRST_STRING,
+            CHILD_IDS,
+            STRING_START,
+            KINDS,
+            TEXT,
+            SECTION_COUNT,
+        };
+
+        std::ostream &out;
+        FILE *sections[SECTION_COUNT];
+        uint32_t node_count = 0;
+        uint32_t child_count = 0;
+        uint32_t string_count = 0;
+        uint32_t text_size = 0;
+        std::vector<NodeId> roots;
+
+        // the open root is written last, once all of its children have ids
+        bool in_root = false;
+        Kind root_kind = AND;
+        std::vector<NodeId> root_children;
+
+        BinarySink(std::ostream &out);
+        ~BinarySink();
+
+        void open_root(Kind kind) override;
+        void node(const Tree &tree, NodeId node) override;
+        void close_root() override;
+        void finish() override;
+
+    private:
+        void write_words(Section section, const std::vector<uint32_t> &words);
+    };
+};
@@ -1,16 +1,42 @@
 #pragma once
 #include <vector>
+#include "value/heap.hpp"
 
 struct Value;
-struct Array
+struct Array : HeapObject<Array>
 {
     std::vector<Value> elements;
 
-    Array(std::vector<Value> elements) : elements(elements) {}
+    // range(start, stop, step) only keeps its bounds, and element i is computed as
+    // start + i * step. the elements are built the first time something needs them as values
+    bool lazy = false;
+    int start = 0;
+    int stop = 0;
+    int step = 1;
+    int count = 0;
+
+    Array(std::vector<Value> elements);
+
+    Array(int start, int stop, int step);
+
+    size_t size() const
+    {
+        return lazy ? count : elements.size();
+    }
+
+    // element index of a range. index < count, so the result lies between start and stop, but
+    // index * step alone can go past int
+    int at(int index) const
+    {
+        return (int)(start + (long long)index * step);
+    }
 
     Value operator[](int index);
 
     Value operator[](Value index);
 
     void set(Value index, Value value);
+
+    // the elements of a range, built once. every other array already has them
+    std::vector<Value> &materialize();
 };
@@ -2,24 +2,43 @@
 
 #include <memory>
 #include "ast_nodes/ast.hpp"
+#include "environment.hpp"
+#include "value/heap.hpp"
+
+// --max-depth: how deep calls may nest before the program stops with an error, the same in the
+// VM and the interpreter. tail calls reuse their caller's frame and don't count. 0 leaves it at
+// the default. the interpreter also stops when its native stack fills up, past 200000 calls
+const int DEFAULT_MAX_CALL_DEPTH = 200000;
+void set_max_call_depth(int depth);
+int max_call_depth();
 
 struct Interpreter;
 struct Value;
-struct Callable
+struct FunctionProto;
+struct Upvalue;
+struct Callable : HeapObject<Callable>
 {
-    std::vector<std::unique_ptr<IdentifierType>> params;
-    std::unique_ptr<BlockStmt> block;
+    // the body stays in the Program's arena: a function declaration runs its block, a lambda
+    // returns its expr
+    NodeList<IdentifierType> params;
+    BlockStmt *block = nullptr;
+    Expr *expr = nullptr;
+    std::shared_ptr<Environment<Value>::Frame> closure;
+
+    // set when the callable was created by the VM. each capture holds a reference
+    FunctionProto *proto = nullptr;
+    std::vector<Upvalue *> captures;
 
     void call(Interpreter *interpreter, std::vector<Value> args);
 
-    Callable(FnDecl *fn_decl) : block(std::move(fn_decl->block)), params(std::move(fn_decl->params)) {}
-    Callable(LambdaExpr *lambda_expr) : params(std::move(lambda_expr->params))
+    Callable(FunctionProto *proto);
+    ~Callable();
+    Callable(FnDecl *fn_decl, std::shared_ptr<Environment<Value>::Frame> closure) : params(fn_decl->params), block(fn_decl->block), closure(closure)
     {
-        auto expr = std::move(lambda_expr->expr);
-
-        auto stmts = std::vector<std::unique_ptr<Stmt>>();
-
-        stmts.push_back(std::unique_ptr<ReturnStmt>(new ReturnStmt(std::move(expr))));
-        block = std::unique_ptr<BlockStmt>(new BlockStmt(std::move(stmts)));
+        set_bytes(sizeof(Callable));
+    }
+    Callable(LambdaExpr *lambda_expr, std::shared_ptr<Environment<Value>::Frame> closure) : params(lambda_expr->params), expr(lambda_expr->expr), closure(closure)
+    {
+        set_bytes(sizeof(Callable));
     }
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+
+// bytes held by strings, arrays and callables, reported by --gc-stats.
+// atomic since concurrent @loads allocate on several threads
+struct HeapStats
+{
+    std::atomic<size_t> allocated{0};
+    std::atomic<size_t> freed{0};
+
+    void report(std::ostream &out)
+    {
+        out << "heap: " << allocated << " bytes allocated, " << freed << " bytes freed, "
+            << allocated - freed << " bytes retained" << std::endl;
+    }
+};
+
+inline HeapStats &heap_stats()
+{
+    static HeapStats stats;
+    return stats;
+}
+
+// intrusive reference count for heap values. a new object has no owners: the first Value that
+// holds it takes a reference, and the object is freed when the last one lets go.
+// reference cycles (an array stored inside itself, a function stored in the scope it closes
+// over) are never freed and show up as retained bytes
+template <typename T>
+struct HeapObject
+{
+    int refcount = 0;
+    size_t bytes = 0;
+
+    ~HeapObject()
+    {
+        heap_stats().freed += bytes;
+    }
+
+    void retain()
+    {
+        refcount++;
+    }
+
+    void release()
+    {
+        if (--refcount == 0)
+        {
+            delete static_cast<T *>(this);
+        }
+    }
+
+    // called whenever the object's footprint changes
+    void set_bytes(size_t new_bytes)
+    {
+        if (new_bytes > bytes)
+        {
+            heap_stats().allocated += new_bytes - bytes;
+        }
+        else
+        {
+            heap_stats().freed += bytes - new_bytes;
+        }
+        bytes = new_bytes;
+    }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "value/heap.hpp"
+
+// immutable, reference counted storage for string values. interned strings are owned by the
+// intern table and live for the rest of the process, so they skip reference counting and
+// two interned strings are equal exactly when they are the same pointer
+struct String : HeapObject<String>
+{
+    std::string chars;
+    bool interned = false;
+
+    String(std::string chars) : chars(std::move(chars))
+    {
+        set_bytes(sizeof(String) + this->chars.capacity());
+    }
+
+    void retain()
+    {
+        if (!interned)
+        {
+            HeapObject::retain();
+        }
+    }
+
+    void release()
+    {
+        if (!interned)
+        {
+            HeapObject::release();
+        }
+    }
+
+    static String *intern(const std::string &chars)
+    {
+        static std::unordered_map<std::string, String *> table;
+        static std::mutex mutex;
+
+        // the compiler interns too, and compiles run on every load worker
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = table.find(chars);
+        if (it != table.end())
+        {
+            return it->second;
+        }
+
+        auto string = new String(chars);
+        string->interned = true;
+        table[chars] = string;
+        return string;
+    }
+};
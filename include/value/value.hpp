@@ -1,13 +1,18 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <vector>
+#include <cmath>
+#include "ast_nodes/operators.hpp"
 #include "ast_nodes/ast.hpp"
-#include "exceptions/return.hpp"
+#include "error_exit.hpp"
 #include "value/callable.hpp"
 #include "value/array.hpp"
+#include "value/string.hpp"
 
-enum MyType
+enum MyType : uint8_t
 {
     MYINT,
     MYFLOAT,
@@ -16,355 +21,442 @@ enum MyType
     MYNONE,
     MYFUNCTION,
     MYARRAY,
+    MYTYPE_COUNT,
 };
 
+// a tag plus an 8 byte payload. ints, floats, bools and None are stored inline, so copying
+// them is a plain copy of the payload. strings of up to 8 chars are stored inline as well;
+// longer strings, arrays and callables are reference counted heap objects
 struct Value
 {
-    // TODO: turn this into a variant
+    static const uint8_t HEAP_STRING = 0xff;
+    static const size_t MAX_INLINE_STRING = 8;
+
     union
     {
         int int_value;
         float float_value;
-        std::string string_value;
         bool bool_value;
+        String *string_value;
+        char inline_chars[MAX_INLINE_STRING];
         Callable *callable;
         Array *array;
+        uint64_t bits;
     };
 
     MyType type;
+    uint8_t string_length = HEAP_STRING; // length of an inline string, or HEAP_STRING
 
-    Value() : type(MyType::MYNONE) {}
-    Value(int value) : int_value(value), type(MyType::MYINT) {}
-    Value(float value) : float_value(value), type(MyType::MYFLOAT) {}
-    Value(std::string value) : string_value(value), type(MyType::MYSTRING) {}
-    Value(bool value) : bool_value(value), type(MyType::MYBOOL) {}
-    Value(Callable *value) : callable(value), type(MyType::MYFUNCTION) {}
-    Value(Array *value) : array(value), type(MyType::MYARRAY) {}
-
-    Value(const Value &other) : type(other.type)
+    Value() : bits(0), type(MyType::MYNONE) {}
+    Value(int value) : bits(0), type(MyType::MYINT) { int_value = value; }
+    Value(float value) : bits(0), type(MyType::MYFLOAT) { float_value = value; }
+    Value(const std::string &value) : bits(0), type(MyType::MYSTRING)
     {
-        switch (type)
+        if (value.size() <= MAX_INLINE_STRING)
         {
-        case MyType::MYINT:
-            int_value = other.int_value;
-            break;
-        case MyType::MYFLOAT:
-            float_value = other.float_value;
-            break;
-        case MyType::MYSTRING:
-            new (&string_value) std::string(other.string_value);
-            break;
-        case MyType::MYBOOL:
-            bool_value = other.bool_value;
-            break;
-        case MyType::MYFUNCTION:
-            callable = other.callable;
-            break;
-        case MyType::MYARRAY:
-            array = other.array;
-            break;
-        default:
-            break;
+            memcpy(inline_chars, value.data(), value.size());
+            string_length = value.size();
+        }
+        else
+        {
+            string_value = new String(value);
+            string_value->retain();
         }
     }
+    Value(String *value) : string_value(value), type(MyType::MYSTRING) { value->retain(); }
+    Value(bool value) : bits(0), type(MyType::MYBOOL) { bool_value = value; }
+    Value(Callable *value) : callable(value), type(MyType::MYFUNCTION) { value->retain(); }
+    Value(Array *value) : array(value), type(MyType::MYARRAY) { value->retain(); }
+
+    Value(const Value &other) : bits(other.bits), type(other.type), string_length(other.string_length)
+    {
+        retain();
+    }
+
+    Value(Value &&other) : bits(other.bits), type(other.type), string_length(other.string_length)
+    {
+        other.type = MyType::MYNONE;
+    }
 
     ~Value()
     {
-        if (type == MyType::MYSTRING)
-        {
-            string_value.~basic_string();
-        }
+        release();
     }
 
-    Value operator=(const Value &other)
+    Value &operator=(const Value &other)
     {
         if (this == &other)
         {
             return *this;
         }
 
+        release();
+        bits = other.bits;
         type = other.type;
+        string_length = other.string_length;
+        retain();
+        return *this;
+    }
 
-        switch (type)
+    Value &operator=(Value &&other)
+    {
+        if (this == &other)
         {
-        case MyType::MYINT:
-            int_value = other.int_value;
-            break;
-        case MyType::MYFLOAT:
-            float_value = other.float_value;
-            break;
-        case MyType::MYSTRING:
-            new (&string_value) std::string(other.string_value);
-            break;
-        case MyType::MYBOOL:
-            bool_value = other.bool_value;
-            break;
-        case MyType::MYFUNCTION:
-            callable = other.callable;
-            break;
-        case MyType::MYARRAY:
-            array = other.array;
-            break;
-        default:
-            break;
+            return *this;
         }
 
+        release();
+        bits = other.bits;
+        type = other.type;
+        string_length = other.string_length;
+        other.type = MyType::MYNONE;
         return *this;
     }
 
-    Value operator+(const Value &other)
+    bool is_heap_string() const
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value + other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value + other.float_value);
-        }
-        else if (type == MyType::MYSTRING && other.type == MyType::MYSTRING)
-        {
-            return Value(string_value + other.string_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for addition" << std::endl;
-            exit(1);
-        }
+        return type == MyType::MYSTRING && string_length == HEAP_STRING;
     }
 
-    Value operator-(const Value &other)
+    const char *chars() const
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value - other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value - other.float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for subtraction" << std::endl;
-            exit(1);
-        }
+        return is_heap_string() ? string_value->chars.data() : inline_chars;
     }
 
-    Value operator*(const Value &other)
+    size_t length() const
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value * other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value * other.float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for multiplication" << std::endl;
-            exit(1);
-        }
+        return is_heap_string() ? string_value->chars.size() : string_length;
     }
 
-    Value operator/(const Value &other)
+    std::string str() const
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value / other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value / other.float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for division" << std::endl;
-            exit(1);
-        }
+        return is_heap_string() ? string_value->chars : std::string(inline_chars, string_length);
     }
 
-    Value operator%(const Value &other)
+    static bool strings_equal(const Value &left, const Value &right)
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
+        if (left.is_heap_string() && right.is_heap_string())
         {
-            return Value(int_value % other.int_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for modulo" << std::endl;
-            exit(1);
+            if (left.string_value == right.string_value)
+            {
+                return true;
+            }
+            if (left.string_value->interned && right.string_value->interned)
+            {
+                return false;
+            }
         }
+
+        return left.length() == right.length() && memcmp(left.chars(), right.chars(), left.length()) == 0;
     }
 
-    Value operator==(const Value &other)
+    void retain()
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value == other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value == other.float_value);
-        }
-        else if (type == MyType::MYSTRING && other.type == MyType::MYSTRING)
-        {
-            return Value(string_value == other.string_value);
-        }
-        else if (type == MyType::MYBOOL && other.type == MyType::MYBOOL)
-        {
-            return Value(bool_value == other.bool_value);
-        }
-        else
+        switch (type)
         {
-            std::cerr << "Invalid types for equality" << std::endl;
-            exit(1);
+        case MyType::MYSTRING:
+            if (string_length == HEAP_STRING)
+            {
+                string_value->retain();
+            }
+            break;
+        case MyType::MYFUNCTION:
+            callable->retain();
+            break;
+        case MyType::MYARRAY:
+            array->retain();
+            break;
+        default:
+            break;
         }
     }
 
-    Value operator!=(const Value &other)
+    void release()
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value != other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value != other.float_value);
-        }
-        else if (type == MyType::MYSTRING && other.type == MyType::MYSTRING)
-        {
-            return Value(string_value != other.string_value);
-        }
-        else if (type == MyType::MYBOOL && other.type == MyType::MYBOOL)
-        {
-            return Value(bool_value != other.bool_value);
-        }
-        else
+        switch (type)
         {
-            std::cerr << "Invalid types for inequality" << std::endl;
-            exit(1);
+        case MyType::MYSTRING:
+            if (string_length == HEAP_STRING)
+            {
+                string_value->release();
+            }
+            break;
+        case MyType::MYFUNCTION:
+            callable->release();
+            break;
+        case MyType::MYARRAY:
+            array->release();
+            break;
+        default:
+            break;
         }
     }
 
-    Value operator<(const Value &other)
+    static Value binary(BinaryOperator op, const Value &left, const Value &right);
+    static Value unary(UnaryOperator op, const Value &value);
+    // false when the operation would be a type error
+    static bool binary_defined(BinaryOperator op, MyType left, MyType right);
+    static bool unary_defined(UnaryOperator op, MyType type);
+
+    Value operator+(const Value &other) { return binary(BINARY_ADD, *this, other); }
+    Value operator-(const Value &other) { return binary(BINARY_SUB, *this, other); }
+    Value operator*(const Value &other) { return binary(BINARY_MUL, *this, other); }
+    Value operator/(const Value &other) { return binary(BINARY_DIV, *this, other); }
+    Value operator%(const Value &other) { return binary(BINARY_MOD, *this, other); }
+    Value operator==(const Value &other) { return binary(BINARY_EQ, *this, other); }
+    Value operator!=(const Value &other) { return binary(BINARY_NE, *this, other); }
+    Value operator<(const Value &other) { return binary(BINARY_LT, *this, other); }
+    Value operator<=(const Value &other) { return binary(BINARY_LE, *this, other); }
+    Value operator>(const Value &other) { return binary(BINARY_GT, *this, other); }
+    Value operator>=(const Value &other) { return binary(BINARY_GE, *this, other); }
+    Value operator!() { return unary(UNARY_NOT, *this); }
+    Value operator-() { return unary(UNARY_NEG, *this); }
+
+    std::string to_string()
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value < other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value < other.float_value);
-        }
-        else
+        switch (type)
         {
-            std::cerr << "Invalid types for less than" << std::endl;
-            exit(1);
+        case MyType::MYINT:
+            return std::to_string(int_value);
+        case MyType::MYFLOAT:
+            return std::to_string(float_value);
+        case MyType::MYSTRING:
+            return str();
+        case MyType::MYBOOL:
+            return bool_value ? "true" : "false";
+        case MyType::MYNONE:
+            return "None";
+        case MyType::MYFUNCTION:
+            return "Function";
+        case MyType::MYARRAY:
+            return "Array";
+        default:
+            return "Unknown";
         }
     }
+};
 
-    Value operator<=(const Value &other)
+// semantics for every (operator, left type, right type) triple. anything without a
+// specialization below is a type error
+typedef Value (*BinaryRule)(const Value &, const Value &);
+typedef Value (*UnaryRule)(const Value &);
+
+template <BinaryOperator OP, MyType LEFT, MyType RIGHT>
+struct BinaryImpl
+{
+    static const bool defined = false;
+
+    static Value apply(const Value &left, const Value &right)
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value <= other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
+        if (LEFT != RIGHT)
         {
-            return Value(float_value <= other.float_value);
+            error_output() << "Binary operation between different types" << std::endl;
         }
         else
         {
-            std::cerr << "Invalid types for less than or equal" << std::endl;
-            exit(1);
+            error_output() << "Invalid types for " << operator_description(OP) << std::endl;
         }
+        error_exit();
     }
+};
+
+template <UnaryOperator OP, MyType TYPE>
+struct UnaryImpl
+{
+    static const bool defined = false;
 
-    Value operator>(const Value &other)
+    static Value apply(const Value &value)
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value > other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value > other.float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for greater than" << std::endl;
-            exit(1);
-        }
+        error_output() << "Invalid type for " << operator_description(OP) << std::endl;
+        error_exit();
     }
+};
+
+#define BINARY_RULE(OP, TYPE, FIELD, EXPR)                                  \
+    template <>                                                             \
+    struct BinaryImpl<OP, TYPE, TYPE>                                       \
+    {                                                                       \
+        static const bool defined = true;                                   \
+                                                                            \
+        static Value apply(const Value &left, const Value &right)           \
+        {                                                                   \
+            const auto &a = left.FIELD;                                     \
+            const auto &b = right.FIELD;                                    \
+            return Value(EXPR);                                             \
+        }                                                                   \
+    };
+
+#define UNARY_RULE(OP, TYPE, FIELD, EXPR)                                   \
+    template <>                                                             \
+    struct UnaryImpl<OP, TYPE>                                              \
+    {                                                                       \
+        static const bool defined = true;                                   \
+                                                                            \
+        static Value apply(const Value &value)                              \
+        {                                                                   \
+            const auto &a = value.FIELD;                                    \
+            return Value(EXPR);                                             \
+        }                                                                   \
+    };
 
-    Value operator>=(const Value &other)
+inline int checked_int_divisor(int b)
+{
+    if (b == 0)
     {
-        if (type == MyType::MYINT && other.type == MyType::MYINT)
-        {
-            return Value(int_value >= other.int_value);
-        }
-        else if (type == MyType::MYFLOAT && other.type == MyType::MYFLOAT)
-        {
-            return Value(float_value >= other.float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid types for greater than or equal" << std::endl;
-            exit(1);
-        }
+        error_output() << "Division by zero" << std::endl;
+        error_exit();
     }
+    return b;
+}
 
-    Value operator!()
+inline int int_pow(int base, int exponent)
+{
+    int result = 1;
+    for (; exponent > 0; exponent--)
     {
-        if (type == MyType::MYBOOL)
-        {
-            return Value(!bool_value);
-        }
-        else
-        {
-            std::cerr << "Invalid type for logical not" << std::endl;
-            exit(1);
-        }
+        result *= base;
     }
+    return result;
+}
 
-    Value operator-()
+BINARY_RULE(BINARY_ADD, MYINT, int_value, a + b)
+BINARY_RULE(BINARY_ADD, MYFLOAT, float_value, a + b)
+BINARY_RULE(BINARY_ADD, MYSTRING, str(), a + b)
+BINARY_RULE(BINARY_SUB, MYINT, int_value, a - b)
+BINARY_RULE(BINARY_SUB, MYFLOAT, float_value, a - b)
+BINARY_RULE(BINARY_MUL, MYINT, int_value, a * b)
+BINARY_RULE(BINARY_MUL, MYFLOAT, float_value, a * b)
+BINARY_RULE(BINARY_DIV, MYINT, int_value, a / checked_int_divisor(b))
+BINARY_RULE(BINARY_DIV, MYFLOAT, float_value, a / b)
+BINARY_RULE(BINARY_MOD, MYINT, int_value, a % checked_int_divisor(b))
+BINARY_RULE(BINARY_POW, MYINT, int_value, int_pow(a, b))
+BINARY_RULE(BINARY_POW, MYFLOAT, float_value, std::pow(a, b))
+BINARY_RULE(BINARY_EQ, MYINT, int_value, a == b)
+BINARY_RULE(BINARY_EQ, MYFLOAT, float_value, a == b)
+BINARY_RULE(BINARY_EQ, MYBOOL, bool_value, a == b)
+BINARY_RULE(BINARY_NE, MYINT, int_value, a != b)
+BINARY_RULE(BINARY_NE, MYFLOAT, float_value, a != b)
+BINARY_RULE(BINARY_NE, MYBOOL, bool_value, a != b)
+BINARY_RULE(BINARY_LT, MYINT, int_value, a < b)
+BINARY_RULE(BINARY_LT, MYFLOAT, float_value, a < b)
+BINARY_RULE(BINARY_LE, MYINT, int_value, a <= b)
+BINARY_RULE(BINARY_LE, MYFLOAT, float_value, a <= b)
+BINARY_RULE(BINARY_GT, MYINT, int_value, a > b)
+BINARY_RULE(BINARY_GT, MYFLOAT, float_value, a > b)
+BINARY_RULE(BINARY_GE, MYINT, int_value, a >= b)
+BINARY_RULE(BINARY_GE, MYFLOAT, float_value, a >= b)
+BINARY_RULE(BINARY_AND, MYBOOL, bool_value, a && b)
+BINARY_RULE(BINARY_OR, MYBOOL, bool_value, a || b)
+
+template <>
+struct BinaryImpl<BINARY_EQ, MYSTRING, MYSTRING>
+{
+    static const bool defined = true;
+
+    static Value apply(const Value &left, const Value &right)
     {
-        if (type == MyType::MYINT)
-        {
-            return Value(-int_value);
-        }
-        else if (type == MyType::MYFLOAT)
-        {
-            return Value(-float_value);
-        }
-        else
-        {
-            std::cerr << "Invalid type for negation" << std::endl;
-            exit(1);
-        }
+        return Value(Value::strings_equal(left, right));
     }
+};
 
-    std::string to_string()
+template <>
+struct BinaryImpl<BINARY_NE, MYSTRING, MYSTRING>
+{
+    static const bool defined = true;
+
+    static Value apply(const Value &left, const Value &right)
     {
-        switch (type)
-        {
-        case MyType::MYINT:
-            return std::to_string(int_value);
-        case MyType::MYFLOAT:
-            return std::to_string(float_value);
-        case MyType::MYSTRING:
-            return string_value;
-        case MyType::MYBOOL:
-            return bool_value ? "true" : "false";
-        case MyType::MYNONE:
-            return "None";
-        case MyType::MYFUNCTION:
-            return "Function";
-        case MyType::MYARRAY:
-            return "Array";
-        default:
-            return "Unknown";
-        }
+        return Value(!Value::strings_equal(left, right));
     }
 };
+
+UNARY_RULE(UNARY_NEG, MYINT, int_value, -a)
+UNARY_RULE(UNARY_NEG, MYFLOAT, float_value, -a)
+UNARY_RULE(UNARY_NOT, MYBOOL, bool_value, !a)
+
+static_assert(sizeof(Value) <= 16, "Value should be a tag plus an 8 byte payload");
+
+#undef BINARY_RULE
+#undef UNARY_RULE
+
+// the tables are constant-initialized, so lookups never run any setup code. ENTRY picks
+// what each cell holds: the rule itself, or whether the rule is defined
+#define BINARY_APPLY(OP, LEFT, RIGHT) &BinaryImpl<OP, LEFT, RIGHT>::apply
+#define BINARY_DEFINED(OP, LEFT, RIGHT) BinaryImpl<OP, LEFT, RIGHT>::defined
+#define UNARY_APPLY(OP, TYPE) &UnaryImpl<OP, TYPE>::apply
+#define UNARY_DEFINED(OP, TYPE) UnaryImpl<OP, TYPE>::defined
+
+#define BINARY_COLUMNS(ENTRY, OP, LEFT)                                                                 \
+    {                                                                                                   \
+        ENTRY(OP, LEFT, MYINT), ENTRY(OP, LEFT, MYFLOAT), ENTRY(OP, LEFT, MYSTRING),                    \
+            ENTRY(OP, LEFT, MYBOOL), ENTRY(OP, LEFT, MYNONE), ENTRY(OP, LEFT, MYFUNCTION),              \
+            ENTRY(OP, LEFT, MYARRAY)                                                                    \
+    }
+
+#define BINARY_ROWS(ENTRY, OP)                                                                          \
+    {                                                                                                   \
+        BINARY_COLUMNS(ENTRY, OP, MYINT), BINARY_COLUMNS(ENTRY, OP, MYFLOAT),                           \
+            BINARY_COLUMNS(ENTRY, OP, MYSTRING), BINARY_COLUMNS(ENTRY, OP, MYBOOL),                     \
+            BINARY_COLUMNS(ENTRY, OP, MYNONE), BINARY_COLUMNS(ENTRY, OP, MYFUNCTION),                   \
+            BINARY_COLUMNS(ENTRY, OP, MYARRAY)                                                          \
+    }
+
+#define BINARY_TABLE(ENTRY)                                                                             \
+    {                                                                                                   \
+        BINARY_ROWS(ENTRY, BINARY_ADD), BINARY_ROWS(ENTRY, BINARY_SUB), BINARY_ROWS(ENTRY, BINARY_MUL), \
+            BINARY_ROWS(ENTRY, BINARY_DIV), BINARY_ROWS(ENTRY, BINARY_MOD),                             \
+            BINARY_ROWS(ENTRY, BINARY_POW), BINARY_ROWS(ENTRY, BINARY_EQ),                              \
+            BINARY_ROWS(ENTRY, BINARY_NE), BINARY_ROWS(ENTRY, BINARY_LT),                               \
+            BINARY_ROWS(ENTRY, BINARY_LE), BINARY_ROWS(ENTRY, BINARY_GT),                               \
+            BINARY_ROWS(ENTRY, BINARY_GE), BINARY_ROWS(ENTRY, BINARY_AND),                              \
+            BINARY_ROWS(ENTRY, BINARY_OR)                                                               \
+    }
+
+#define UNARY_ROW(ENTRY, OP)                                                                            \
+    {                                                                                                   \
+        ENTRY(OP, MYINT), ENTRY(OP, MYFLOAT), ENTRY(OP, MYSTRING), ENTRY(OP, MYBOOL), ENTRY(OP, MYNONE), \
+            ENTRY(OP, MYFUNCTION), ENTRY(OP, MYARRAY)                                                   \
+    }
+
+#define UNARY_TABLE(ENTRY)                                                                              \
+    {                                                                                                   \
+        UNARY_ROW(ENTRY, UNARY_NEG), UNARY_ROW(ENTRY, UNARY_NOT)                                        \
+    }
+
+inline Value Value::binary(BinaryOperator op, const Value &left, const Value &right)
+{
+    static const BinaryRule table[BINARY_OPERATOR_COUNT][MYTYPE_COUNT][MYTYPE_COUNT] = BINARY_TABLE(BINARY_APPLY);
+
+    return table[op][left.type][right.type](left, right);
+}
+
+inline Value Value::unary(UnaryOperator op, const Value &value)
+{
+    static const UnaryRule table[UNARY_OPERATOR_COUNT][MYTYPE_COUNT] = UNARY_TABLE(UNARY_APPLY);
+
+    return table[op][value.type](value);
+}
+
+inline bool Value::binary_defined(BinaryOperator op, MyType left, MyType right)
+{
+    static const bool table[BINARY_OPERATOR_COUNT][MYTYPE_COUNT][MYTYPE_COUNT] = BINARY_TABLE(BINARY_DEFINED);
+
+    return table[op][left][right];
+}
+
+inline bool Value::unary_defined(UnaryOperator op, MyType type)
+{
+    static const bool table[UNARY_OPERATOR_COUNT][MYTYPE_COUNT] = UNARY_TABLE(UNARY_DEFINED);
+
+    return table[op][type];
+}
+
+#undef BINARY_APPLY
+#undef BINARY_DEFINED
+#undef UNARY_APPLY
+#undef UNARY_DEFINED
+#undef BINARY_TABLE
+#undef UNARY_TABLE
+#undef BINARY_COLUMNS
+#undef BINARY_ROWS
+#undef UNARY_ROW
@@ -0,0 +1,973 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ast_nodes/ast.hpp"
+#include "error_exit.hpp"
+#include "standard_lib.hpp"
+#include "visitors/visitor.hpp"
+#include "vm/chunk.hpp"
+
+// lowers a Program into register bytecode for the VM
+struct Compiler : Visitor
+{
+    static const uint16_t NO_DEST = 0xffff;
+
+    enum VarKind
+    {
+        LOCAL,
+        CAPTURE,
+        GLOBAL,
+    };
+
+    struct Resolved
+    {
+        VarKind kind;
+        uint16_t index;
+    };
+
+    struct Local
+    {
+        std::string identifier;
+        uint16_t reg;
+        bool captured; // its register is closed over when it goes out of scope. false when left out
+    };
+
+    struct Scope
+    {
+        size_t locals;
+        uint16_t free_reg;
+    };
+
+    struct Loop
+    {
+        uint32_t continue_target;
+        uint16_t level;        // the first register of the loop's own variables
+        bool captures = false; // one of them is captured, so leaving an iteration closes it
+        std::vector<size_t> breaks;
+        std::vector<size_t> continues;
+
+        Loop(uint32_t continue_target, uint16_t level) : continue_target(continue_target), level(level) {}
+    };
+
+    struct FunctionState
+    {
+        FunctionProto *proto;
+        FunctionState *enclosing;
+        std::vector<Local> locals;
+        std::vector<Scope> scopes;
+        std::vector<std::string> capture_names;
+        std::vector<Loop> loops;
+        uint16_t free_reg = 0;
+
+        FunctionState(FunctionProto *proto, FunctionState *enclosing) : proto(proto), enclosing(enclosing) {}
+    };
+
+    CompiledProgram *compiled = nullptr;
+    bool load_follows = false; // the AtLoadNode being compiled has another one after it
+    bool tail_call = false;    // the CallExpr being compiled is returned by its function
+    FunctionState *fs = nullptr;
+    std::unordered_map<std::string, uint16_t> global_slots;
+    uint16_t dest = NO_DEST; // the register the expression being visited writes its value to
+
+    std::unique_ptr<CompiledProgram> compile(Program *program)
+    {
+        std::unique_ptr<CompiledProgram> result(new CompiledProgram());
+        compiled = result.get();
+
+        auto main = new FunctionProto();
+        main->name = "<main>";
+        compiled->protos.push_back(std::unique_ptr<FunctionProto>(main));
+
+        FunctionState state(main, nullptr);
+        fs = &state;
+
+        for (auto &input : program->inputs)
+        {
+            auto slot = global_slot(input->identifier);
+            compiled->input_slots.push_back(slot);
+
+            // inputs passed in by @load are defined before the program runs, so skip their defaults
+            auto skip = emit(Instruction(OP_JMPDEF, slot));
+            auto reg = alloc_reg();
+            if (auto default_input = dynamic_cast<InputDefault *>(input))
+            {
+                expr(default_input->value, reg);
+            }
+            else
+            {
+                emit(Instruction(OP_LOADNONE, reg));
+            }
+            emit(Instruction(OP_DEFGLOBAL, reg, 0, slot));
+            fs->free_reg = reg;
+            patch(skip);
+        }
+
+        for (int i = 0; i < program->stmts.size(); i++)
+        {
+            auto stmt = program->stmts[program->stmts.size() - 1 - i];
+            stmt->accept(this);
+        }
+
+        program->treeNode->accept(this);
+        emit(Instruction(OP_HALT));
+
+        fs = nullptr;
+        compiled = nullptr;
+        return result;
+    }
+
+    void error(std::string message)
+    {
+        error_output() << message << std::endl;
+        error_exit();
+    }
+
+    size_t emit(Instruction instruction)
+    {
+        fs->proto->code.push_back(instruction);
+        return fs->proto->code.size() - 1;
+    }
+
+    void emit_jump(OpCode op, uint16_t a, uint32_t target)
+    {
+        Instruction instruction(op, a);
+        instruction.set_bx(target);
+        emit(instruction);
+    }
+
+    void patch(size_t at)
+    {
+        fs->proto->code[at].set_bx(fs->proto->code.size());
+    }
+
+    uint32_t here()
+    {
+        return fs->proto->code.size();
+    }
+
+    uint16_t alloc_reg()
+    {
+        if (fs->free_reg >= NO_DEST - 1)
+        {
+            error("Too many registers needed in function " + fs->proto->name);
+        }
+
+        auto reg = fs->free_reg++;
+        if (fs->free_reg > fs->proto->num_registers)
+        {
+            fs->proto->num_registers = fs->free_reg;
+        }
+        return reg;
+    }
+
+    uint32_t add_constant(Value value)
+    {
+        fs->proto->constants.push_back(value);
+        return fs->proto->constants.size() - 1;
+    }
+
+    uint16_t global_slot(const std::string &identifier)
+    {
+        auto it = global_slots.find(identifier);
+        if (it != global_slots.end())
+        {
+            return it->second;
+        }
+
+        if (compiled->globals.size() >= NO_DEST)
+        {
+            error("Too many global variables");
+        }
+
+        uint16_t slot = compiled->globals.size();
+        compiled->globals.push_back(identifier);
+        global_slots[identifier] = slot;
+        return slot;
+    }
+
+    void begin_scope()
+    {
+        fs->scopes.push_back(Scope{fs->locals.size(), fs->free_reg});
+    }
+
+    void end_scope()
+    {
+        auto scope = fs->scopes.back();
+        fs->scopes.pop_back();
+        for (size_t i = scope.locals; i < fs->locals.size(); i++)
+        {
+            if (fs->locals[i].captured)
+            {
+                emit(Instruction(OP_CLOSECAPTURES, scope.free_reg));
+                break;
+            }
+        }
+        fs->locals.resize(scope.locals);
+        fs->free_reg = scope.free_reg;
+    }
+
+    // a nested function captured the local in reg. break and continue jump past the end of
+    // the scopes they leave, so the loops around it close it too
+    void mark_captured(FunctionState *state, const std::string &identifier, uint16_t reg)
+    {
+        for (auto it = state->locals.rbegin(); it != state->locals.rend(); ++it)
+        {
+            if (it->identifier == identifier)
+            {
+                it->captured = true;
+                break;
+            }
+        }
+        for (auto &loop : state->loops)
+        {
+            loop.captures = loop.captures || reg >= loop.level;
+        }
+    }
+
+    // top level declarations outside of any block are globals, everything else lives in a register
+    bool declares_globals()
+    {
+        return fs->enclosing == nullptr && fs->scopes.empty();
+    }
+
+    Resolved resolve(const std::string &identifier)
+    {
+        return resolve(fs, identifier);
+    }
+
+    Resolved resolve(FunctionState *state, const std::string &identifier)
+    {
+        for (auto it = state->locals.rbegin(); it != state->locals.rend(); ++it)
+        {
+            if (it->identifier == identifier)
+            {
+                return Resolved{LOCAL, it->reg};
+            }
+        }
+
+        for (size_t i = 0; i < state->capture_names.size(); i++)
+        {
+            if (state->capture_names[i] == identifier)
+            {
+                return Resolved{CAPTURE, (uint16_t)i};
+            }
+        }
+
+        if (state->enclosing != nullptr)
+        {
+            auto outer = resolve(state->enclosing, identifier);
+            if (outer.kind == LOCAL)
+            {
+                mark_captured(state->enclosing, identifier, outer.index);
+            }
+            if (outer.kind != GLOBAL)
+            {
+                state->proto->captures.push_back(CaptureInfo{outer.kind == LOCAL, outer.index});
+                state->capture_names.push_back(identifier);
+                return Resolved{CAPTURE, (uint16_t)(state->capture_names.size() - 1)};
+            }
+        }
+
+        return Resolved{GLOBAL, global_slot(identifier)};
+    }
+
+    // compiles expr so that its value ends up in reg
+    void expr(Expr *e, uint16_t reg)
+    {
+        auto saved = dest;
+        dest = reg;
+        e->accept(this);
+        dest = saved;
+    }
+
+    // compiles expr into a fresh register unless it is a local that can be read in place
+    uint16_t operand(Expr *e)
+    {
+        if (auto identifier = dynamic_cast<IdentifierExpr *>(e))
+        {
+            auto resolved = resolve(identifier->identifier);
+            if (resolved.kind == LOCAL)
+            {
+                return resolved.index;
+            }
+        }
+
+        auto reg = alloc_reg();
+        expr(e, reg);
+        return reg;
+    }
+
+    uint16_t variable(const std::string &identifier)
+    {
+        auto resolved = resolve(identifier);
+        if (resolved.kind == LOCAL)
+        {
+            return resolved.index;
+        }
+
+        auto reg = alloc_reg();
+        load_variable(resolved, reg);
+        return reg;
+    }
+
+    void load_variable(Resolved resolved, uint16_t reg)
+    {
+        switch (resolved.kind)
+        {
+        case LOCAL:
+            if (resolved.index != reg)
+            {
+                emit(Instruction(OP_MOVE, reg, resolved.index));
+            }
+            break;
+        case CAPTURE:
+            emit(Instruction(OP_GETCAPTURE, reg, resolved.index));
+            break;
+        case GLOBAL:
+            emit(Instruction(OP_GETGLOBAL, reg, 0, resolved.index));
+            break;
+        }
+    }
+
+    // expressions that only write their destination after reading all of their operands
+    bool writes_dest_last(Expr *e)
+    {
+        if (auto binary = dynamic_cast<BinaryExpr *>(e))
+        {
+            return binary->op != BINARY_AND && binary->op != BINARY_OR;
+        }
+
+        return dynamic_cast<UnaryExpr *>(e) || dynamic_cast<IdentifierExpr *>(e) || dynamic_cast<IntLiteral *>(e) ||
+               dynamic_cast<FloatLiteral *>(e) || dynamic_cast<StringLiteral *>(e) || dynamic_cast<BoolLiteral *>(e);
+    }
+
+    uint32_t compile_function(std::string name, NodeList<IdentifierType> &params, BlockStmt *block, Expr *body)
+    {
+        auto proto = new FunctionProto();
+        proto->name = name;
+        uint32_t index = compiled->protos.size();
+        compiled->protos.push_back(std::unique_ptr<FunctionProto>(proto));
+
+        FunctionState state(proto, fs);
+        fs = &state;
+
+        // params are stored last to first
+        proto->num_params = params.size();
+        for (int i = 0; i < params.size(); i++)
+        {
+            fs->locals.push_back(Local{params[params.size() - 1 - i]->identifier, alloc_reg()});
+        }
+
+        if (block != nullptr)
+        {
+            block->accept(this);
+            emit(Instruction(OP_RETURNNONE));
+        }
+        else
+        {
+            auto reg = alloc_reg();
+            expr(body, reg);
+            emit(Instruction(OP_RETURN, reg));
+        }
+
+        fs = state.enclosing;
+        return index;
+    }
+
+    void emit_closure(uint16_t reg, uint32_t proto)
+    {
+        Instruction instruction(OP_CLOSURE, reg);
+        instruction.set_bx(proto);
+        emit(instruction);
+    }
+
+    void compile_children(NodeList<TreeNode> &children)
+    {
+        for (int i = 0; i < children.size(); i++)
+        {
+            // a load followed by a sibling load is queued, so the run can be evaluated together
+            load_follows = i + 1 < children.size() && dynamic_cast<AtLoadNode *>(children[children.size() - i - 2]) != nullptr;
+            children[children.size() - i - 1]->accept(this);
+        }
+        load_follows = false;
+    }
+
+    // the end of an iteration, where continue goes
+    void loop_continue(Loop &loop)
+    {
+        if (!loop.captures)
+        {
+            for (auto &jump : loop.continues)
+            {
+                fs->proto->code[jump].set_bx(loop.continue_target);
+            }
+            return;
+        }
+
+        for (auto &jump : loop.continues)
+        {
+            patch(jump);
+        }
+        emit(Instruction(OP_CLOSECAPTURES, loop.level));
+    }
+
+    void loop_end(Loop &loop)
+    {
+        for (auto &jump : loop.breaks)
+        {
+            patch(jump);
+        }
+        if (loop.captures && !loop.breaks.empty())
+        {
+            emit(Instruction(OP_CLOSECAPTURES, loop.level));
+        }
+    }
+
+    virtual void visit(IfStmt *stmt) override
+    {
+        auto mark = fs->free_reg;
+        auto condition = operand(stmt->condition);
+        auto skip = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        stmt->then_block->accept(this);
+        patch(skip);
+    }
+
+    virtual void visit(IfElseStmt *stmt) override
+    {
+        auto mark = fs->free_reg;
+        auto condition = operand(stmt->condition);
+        auto to_else = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        stmt->then_block->accept(this);
+        auto to_end = emit(Instruction(OP_JMP));
+        patch(to_else);
+        stmt->else_block->accept(this);
+        patch(to_end);
+    }
+
+    virtual void visit(WhileStmt *stmt) override
+    {
+        auto start = here();
+        auto mark = fs->free_reg;
+        auto condition = operand(stmt->condition);
+        auto exit_jump = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        fs->loops.push_back(Loop(start, fs->free_reg));
+        stmt->block->accept(this);
+        loop_continue(fs->loops.back());
+        emit_jump(OP_JMP, 0, start);
+        patch(exit_jump);
+        loop_end(fs->loops.back());
+        fs->loops.pop_back();
+    }
+
+    virtual void visit(ForInStmt *stmt) override
+    {
+        // three hidden registers: the iterable, the index and the loop variable
+        begin_scope();
+        auto base = alloc_reg();
+        alloc_reg();
+        alloc_reg();
+
+        expr(stmt->iterable, base);
+        emit(Instruction(OP_FORPREP, base));
+
+        auto start = here();
+        auto exit_jump = emit(Instruction(OP_FORNEXT, base));
+
+        begin_scope();
+        fs->locals.push_back(Local{stmt->identifier, (uint16_t)(base + 2)});
+        fs->loops.push_back(Loop(start, base));
+        stmt->block->accept(this);
+        loop_continue(fs->loops.back());
+        end_scope();
+
+        emit_jump(OP_JMP, 0, start);
+        patch(exit_jump);
+        loop_end(fs->loops.back());
+        fs->loops.pop_back();
+        end_scope();
+    }
+
+    virtual void visit(ReturnStmt *stmt) override
+    {
+        if (fs->enclosing == nullptr)
+        {
+            error("Return statement outside of a function");
+        }
+
+        if (stmt->is_void)
+        {
+            emit(Instruction(OP_RETURNNONE));
+            return;
+        }
+
+        auto mark = fs->free_reg;
+        if (stmt->tail_call)
+        {
+            // the call replaces this frame and returns to our caller itself
+            tail_call = true;
+            expr(stmt->expr, NO_DEST);
+        }
+        else
+        {
+            emit(Instruction(OP_RETURN, operand(stmt->expr)));
+        }
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(BreakStmt *stmt) override
+    {
+        if (fs->loops.empty())
+        {
+            error("Break statement outside of a loop");
+        }
+
+        fs->loops.back().breaks.push_back(emit(Instruction(OP_JMP)));
+    }
+
+    virtual void visit(ContinueStmt *stmt) override
+    {
+        if (fs->loops.empty())
+        {
+            error("Continue statement outside of a loop");
+        }
+
+        fs->loops.back().continues.push_back(emit(Instruction(OP_JMP)));
+    }
+
+    virtual void visit(FnDecl *stmt) override
+    {
+        if (declares_globals())
+        {
+            auto slot = global_slot(stmt->identifier);
+            auto proto = compile_function(stmt->identifier, stmt->params, stmt->block, nullptr);
+            auto reg = alloc_reg();
+            emit_closure(reg, proto);
+            emit(Instruction(OP_DEFGLOBAL, reg, 0, slot));
+            fs->free_reg = reg;
+            return;
+        }
+
+        // declared before the body is compiled so the function can capture itself
+        auto reg = alloc_reg();
+        fs->locals.push_back(Local{stmt->identifier, reg});
+        emit_closure(reg, compile_function(stmt->identifier, stmt->params, stmt->block, nullptr));
+    }
+
+    virtual void visit(VarDecl *stmt) override
+    {
+        auto reg = alloc_reg();
+        expr(stmt->value, reg);
+        fs->free_reg = reg + 1;
+
+        if (declares_globals())
+        {
+            emit(Instruction(OP_DEFGLOBAL, reg, 0, global_slot(stmt->identifier)));
+            fs->free_reg = reg;
+            return;
+        }
+
+        fs->locals.push_back(Local{stmt->identifier, reg});
+    }
+
+    virtual void visit(ExprStmt *stmt) override
+    {
+        auto mark = fs->free_reg;
+        if (dynamic_cast<AssignExpr *>(stmt->expr) || dynamic_cast<ArrayAssignExpr *>(stmt->expr))
+        {
+            expr(stmt->expr, NO_DEST);
+        }
+        else
+        {
+            expr(stmt->expr, alloc_reg());
+        }
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(BlockStmt *stmt) override
+    {
+        begin_scope();
+        for (int i = 0; i < stmt->stmts.size(); i++)
+        {
+            auto s = stmt->stmts[stmt->stmts.size() - i - 1];
+            s->accept(this);
+        }
+        end_scope();
+    }
+
+    virtual void visit(LambdaExpr *expr) override
+    {
+        emit_closure(dest, compile_function("<lambda>", expr->params, nullptr, expr->expr));
+    }
+
+    virtual void visit(AssignExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        auto resolved = resolve(expr->identifier);
+        uint16_t value;
+
+        if (resolved.kind == LOCAL && writes_dest_last(expr->value))
+        {
+            value = resolved.index;
+            this->expr(expr->value, value);
+        }
+        else
+        {
+            value = alloc_reg();
+            this->expr(expr->value, value);
+            switch (resolved.kind)
+            {
+            case LOCAL:
+                emit(Instruction(OP_MOVE, resolved.index, value));
+                break;
+            case CAPTURE:
+                emit(Instruction(OP_SETCAPTURE, value, resolved.index));
+                break;
+            case GLOBAL:
+                emit(Instruction(OP_SETGLOBAL, value, 0, resolved.index));
+                break;
+            }
+        }
+
+        if (target != NO_DEST && target != value)
+        {
+            emit(Instruction(OP_MOVE, target, value));
+        }
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(ArrayAssignExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        auto array = variable(expr->identifier);
+        auto index = operand(expr->index);
+        auto value = operand(expr->value);
+        emit(Instruction(OP_SETINDEX, array, index, value));
+
+        if (target != NO_DEST)
+        {
+            emit(Instruction(OP_MOVE, target, value));
+        }
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(TernaryExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        auto condition = operand(expr->condition);
+        auto to_else = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        this->expr(expr->then_expr, target);
+        auto to_end = emit(Instruction(OP_JMP));
+        patch(to_else);
+        this->expr(expr->else_expr, target);
+        patch(to_end);
+    }
+
+    virtual void visit(BinaryExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+
+        if (expr->op == BINARY_AND || expr->op == BINARY_OR)
+        {
+            this->expr(expr->left, target);
+            auto skip = emit(Instruction(expr->op == BINARY_AND ? OP_JMPF : OP_JMPT, target));
+            this->expr(expr->right, target);
+            patch(skip);
+            return;
+        }
+
+        // the arithmetic and comparison opcodes are laid out in operator order, once for
+        // unknown operands and once more for each type the TypeChecker can prove
+        static const OpCode base[] = {OP_ADD, OP_ADDI, OP_ADDF};
+        auto op = (OpCode)(base[expr->operands] + expr->op);
+        auto left = operand(expr->left);
+        auto right = operand(expr->right);
+        emit(Instruction(op, target, left, right));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(UnaryExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+
+        auto op = (OpCode)(OP_NEG + expr->op);
+        emit(Instruction(op, target, operand(expr->expr)));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(CallExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        auto tail = tail_call;
+        tail_call = false; // calls in the arguments are not in tail position
+
+        // arguments go in consecutive registers, the result comes back in the first one
+        uint16_t base = fs->free_reg;
+        uint16_t argc = expr->args.size();
+        for (uint16_t i = 0; i < std::max<uint16_t>(argc, 1); i++)
+        {
+            alloc_reg();
+        }
+
+        uint16_t i = 0;
+        for (auto it = expr->args.rbegin(); it != expr->args.rend(); ++it)
+        {
+            this->expr(*it, base + i++);
+        }
+
+        if (expr->native != nullptr)
+        {
+            emit(Instruction(OP_CALLN, base, expr->native - StandardLib::natives(), argc));
+            if (target != NO_DEST && target != base)
+            {
+                emit(Instruction(OP_MOVE, target, base));
+            }
+            fs->free_reg = mark;
+            return;
+        }
+
+        auto resolved = resolve(expr->identifier);
+        switch (resolved.kind)
+        {
+        case LOCAL:
+            emit(Instruction(tail ? OP_TAILCALL : OP_CALL, base, resolved.index, argc));
+            break;
+        case CAPTURE:
+        {
+            auto callee = alloc_reg();
+            emit(Instruction(OP_GETCAPTURE, callee, resolved.index));
+            emit(Instruction(tail ? OP_TAILCALL : OP_CALL, base, callee, argc));
+            break;
+        }
+        case GLOBAL:
+            emit(Instruction(tail ? OP_TAILCALLG : OP_CALLG, base, resolved.index, argc));
+            break;
+        }
+
+        if (!tail && target != NO_DEST && target != base)
+        {
+            emit(Instruction(OP_MOVE, target, base));
+        }
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(ArrayAccessExpr *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        auto array = variable(expr->identifier);
+        auto index = operand(expr->index);
+        emit(Instruction(OP_GETINDEX, target, array, index));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(IntLiteral *expr) override
+    {
+        Instruction instruction(OP_LOADI, dest);
+        instruction.set_bx((uint32_t)expr->value);
+        emit(instruction);
+    }
+
+    virtual void visit(FloatLiteral *expr) override
+    {
+        Instruction instruction(OP_LOADK, dest);
+        instruction.set_bx(add_constant(Value(expr->value)));
+        emit(instruction);
+    }
+
+    virtual void visit(StringLiteral *expr) override
+    {
+        Instruction instruction(OP_LOADK, dest);
+        instruction.set_bx(add_constant(Value(expr->value)));
+        emit(instruction);
+    }
+
+    virtual void visit(NoneLiteral *expr) override
+    {
+        emit(Instruction(OP_LOADNONE, dest));
+    }
+
+    virtual void visit(BoolLiteral *expr) override
+    {
+        emit(Instruction(OP_LOADBOOL, dest, expr->value));
+    }
+
+    virtual void visit(IdentifierExpr *expr) override
+    {
+        load_variable(resolve(expr->identifier), dest);
+    }
+
+    virtual void visit(ArrayLiteral *expr) override
+    {
+        auto target = dest;
+        auto mark = fs->free_reg;
+        uint16_t base = fs->free_reg;
+        uint16_t count = expr->elements.size();
+        for (uint16_t i = 0; i < count; i++)
+        {
+            alloc_reg();
+        }
+
+        uint16_t i = 0;
+        for (auto it = expr->elements.rbegin(); it != expr->elements.rend(); ++it)
+        {
+            this->expr(*it, base + i++);
+        }
+
+        emit(Instruction(OP_NEWARRAY, target, base, count));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(AndNode *node) override
+    {
+        emit(Instruction(OP_OPEN, TREE_AND));
+        compile_children(node->children);
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(OrNode *node) override
+    {
+        emit(Instruction(OP_OPEN, TREE_OR));
+        compile_children(node->children);
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(ThenNode *node) override
+    {
+        emit(Instruction(OP_OPEN, TREE_THEN));
+        compile_children(node->children);
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(BehaviorNode *node) override
+    {
+        auto mark = fs->free_reg;
+        uint16_t base = fs->free_reg;
+        uint16_t count = node->args.size();
+        for (uint16_t i = 0; i < count; i++)
+        {
+            alloc_reg();
+        }
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            expr(node->args[i], base + i);
+        }
+
+        auto name = add_constant(Value(String::intern(node->identifier)));
+        if (name >= NO_DEST)
+        {
+            error("Too many constants in " + fs->proto->name);
+        }
+
+        emit(Instruction(OP_BEHAVIOR, name, base, count));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(AtLoadNode *at_load) override
+    {
+        auto mark = fs->free_reg;
+        uint16_t base = fs->free_reg;
+        uint16_t count = at_load->args.size();
+        for (uint16_t i = 0; i < count; i++)
+        {
+            alloc_reg();
+        }
+
+        uint16_t i = 0;
+        for (auto it = at_load->args.rbegin(); it != at_load->args.rend(); ++it)
+        {
+            expr(*it, base + i++);
+        }
+
+        emit(Instruction(OP_LOAD, load_follows, base, count));
+        fs->free_reg = mark;
+    }
+
+    virtual void visit(AtIfNode *at_if) override
+    {
+        emit(Instruction(OP_OPEN, TREE_PSEUDO));
+
+        auto mark = fs->free_reg;
+        auto condition = operand(at_if->condition);
+        auto skip = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        compile_children(at_if->children);
+        patch(skip);
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(AtIfElseNode *at_if_else) override
+    {
+        emit(Instruction(OP_OPEN, TREE_PSEUDO));
+
+        auto mark = fs->free_reg;
+        auto condition = operand(at_if_else->condition);
+        auto to_else = emit(Instruction(OP_JMPF, condition));
+        fs->free_reg = mark;
+
+        compile_children(at_if_else->then_children);
+        auto to_end = emit(Instruction(OP_JMP));
+        patch(to_else);
+        compile_children(at_if_else->else_children);
+        patch(to_end);
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(AtForNode *at_for) override
+    {
+        emit(Instruction(OP_OPEN, TREE_PSEUDO));
+
+        begin_scope();
+        auto base = alloc_reg();
+        alloc_reg();
+        alloc_reg();
+
+        expr(at_for->iterable, base);
+        emit(Instruction(OP_FORPREP, base));
+
+        auto start = here();
+        auto exit_jump = emit(Instruction(OP_FORNEXT, base));
+
+        begin_scope();
+        fs->locals.push_back(Local{at_for->identifier, (uint16_t)(base + 2)});
+        // the interpreter visits @for children first to last. a run of loads ends with each pass
+        for (int i = 0; i < at_for->children.size(); i++)
+        {
+            load_follows = i + 1 < at_for->children.size() && dynamic_cast<AtLoadNode *>(at_for->children[i + 1]) != nullptr;
+            at_for->children[i]->accept(this);
+        }
+        load_follows = false;
+        end_scope();
+
+        emit_jump(OP_JMP, 0, start);
+        patch(exit_jump);
+        end_scope();
+
+        emit(Instruction(OP_CLOSE));
+    }
+
+    virtual void visit(InputDefault *input) override
+    {
+    }
+
+    virtual void visit(Input *input) override
+    {
+    }
+};
@@ -5,12 +5,13 @@
 #include <limits.h> // For PATH_MAX
 
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <unordered_map>
 #include <map>
-#include <functional>
 #include "dhtt.hpp"
-#include "exceptions/index.hpp"
+#include "error_exit.hpp"
+#include "native_stack.hpp"
 #include "stack.hpp"
 #include "environment.hpp"
 #include "value/array.hpp"
@@ -18,85 +19,136 @@
 #include "value/value.hpp"
 #include "value/callable.hpp"
 #include "parser.hpp"
+#include "loader.hpp"
+#include "visitors/type_checker.hpp"
 
-void ros_parse(Program **root, const char *source);
 
 struct Interpreter : Visitor
 {
+    // how the last statement finished; anything but COMPLETE unwinds the enclosing blocks
+    enum Completion
+    {
+        COMPLETE,
+        BREAKING,
+        CONTINUING,
+        RETURNING,
+    };
+
+    Completion completion = COMPLETE;
+
+    int call_depth = 0;
+
+    // a `return f(...)` leaves the call here for Callable::call to make once the frame is gone
+    bool tail_calling = false;
+    Value tail_callee;
+    std::vector<Value> tail_args;
+
+    // per CallExpr, the one function it has called so far. a call that hits reads the variable
+    // in place and skips the reference count, since the cache keeps the function alive. a site
+    // that sees a second function stops caching. kept here rather than on the CallExpr because
+    // a cached Program is evaluated on several threads at once
+    struct CallSite
+    {
+        Callable *callable = nullptr;
+        bool megamorphic = false;
+    };
+    std::vector<CallSite> call_sites;
 
     Stack<Value> stack;
-    Stack<std::shared_ptr<DHTT::Node>> node_stack;
     Environment<Value> env;
-    std::vector<std::shared_ptr<DHTT::Node>> roots;
-    std::shared_ptr<DHTT::Node> current_root;
+    DHTT::Tree tree;
 
     Interpreter()
     {
         env.push_env();
-        current_root = nullptr;
     }
 
-    void evaluate(Program *program)
+    ~Interpreter()
     {
-        for (auto &input : program->inputs)
+        for (auto &site : call_sites)
         {
-            if (dynamic_cast<InputDefault *>(input.get()))
+            if (site.callable != nullptr)
             {
-                auto default_input = dynamic_cast<InputDefault *>(input.get());
-                default_input->value->accept(this);
-                env.set(input->identifier, stack.pop());
-            }
-            else
-            {
-                input->accept(this);
+                site.callable->release();
             }
         }
+    }
 
-        for (int i = 0; i < program->stmts.size(); i++)
-        {
-            auto &stmt = program->stmts[program->stmts.size() - 1 - i];
-            stmt->accept(this);
-        }
-
-        program->treeNode->accept(this);
-
-        for (int i = 0; i < node_stack.stack.size(); i++)
-        {
-            this->roots.push_back(std::move(node_stack.pop()));
-        }
+    void evaluate(Program *program)
+    {
+        evaluate(program, std::vector<Value>());
     }
 
     void evaluate(Program *program, std::vector<Value> inputs)
     {
-        for (auto &input : program->inputs)
-        {
-            input->accept(this);
-        }
+        // every call nests native frames, so the program runs where they have room
+        on_deep_stack([&]()
+                      { run_program(program, inputs); });
+    }
+
+    void run_program(Program *program, const std::vector<Value> &inputs)
+    {
+        check_inputs(program, inputs);
+        call_sites.resize(program->call_sites);
 
-        for (int i = 0; i < inputs.size(); i++)
+        // inputs that weren't passed fall back to their defaults
+        for (int i = 0; i < program->inputs.size(); i++)
         {
-            env.set(program->inputs[i]->identifier, inputs[i]);
+            if (!uses_default(program->inputs[i], inputs, i))
+            {
+                env.define(program->inputs[i]->slot, inputs[i]);
+            }
+            else if (auto default_input = dynamic_cast<InputDefault *>(program->inputs[i]))
+            {
+                default_input->value->accept(this);
+                env.define(default_input->slot, stack.pop());
+            }
+            else
+            {
+                program->inputs[i]->accept(this);
+            }
         }
 
         for (int i = 0; i < program->stmts.size(); i++)
         {
-            auto &stmt = program->stmts[program->stmts.size() - 1 - i];
+            auto stmt = program->stmts[program->stmts.size() - 1 - i];
             stmt->accept(this);
         }
 
         program->treeNode->accept(this);
-
-        for (int i = 0; i < node_stack.stack.size(); i++)
-        {
-            this->roots.push_back(std::move(node_stack.pop()));
-        }
     }
 
-    void in_new_scope(std::function<void(void)> f)
+    template <typename F>
+    void in_new_scope(F f)
     {
+        auto saved = env.frame;
         env.push_env();
         f();
-        env.pop_env();
+        env.frame = saved;
+    }
+
+    Completion execute(Stmt *stmt)
+    {
+        stmt->accept(this);
+        return completion;
+    }
+
+    // consumes a break or continue at the end of a loop body, returns true if the loop should stop
+    bool loop_should_exit()
+    {
+        switch (completion)
+        {
+        case BREAKING:
+            completion = COMPLETE;
+            return true;
+        case CONTINUING:
+            completion = COMPLETE;
+            return false;
+        case RETURNING:
+            return true;
+        default:
+            return false;
+        }
     }
 
     virtual void visit(IfStmt *stmt) override
@@ -106,8 +158,8 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in if statement condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in if statement condition" << std::endl;
+            error_exit();
         }
 
         if (condition.bool_value)
@@ -123,8 +175,8 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in if statement condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in if statement condition" << std::endl;
+            error_exit();
         }
 
         if (condition.bool_value)
@@ -144,26 +196,19 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in while statement condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in while statement condition" << std::endl;
+            error_exit();
         }
 
         auto condition_bool = condition.bool_value;
 
-        while (condition.bool_value)
+        while (condition_bool)
         {
-            try
-            {
-                stmt->block->accept(this);
-            }
-            catch (BreakException e)
+            execute(stmt->block);
+            if (loop_should_exit())
             {
                 break;
             }
-            catch (ContinueException e)
-            {
-                continue;
-            }
             stmt->condition->accept(this);
             condition_bool = stack.pop().bool_value;
         }
@@ -176,57 +221,67 @@ struct Interpreter : Visitor
 
         if (iterable.type != MyType::MYSTRING && iterable.type != MyType::MYARRAY)
         {
-            std::cerr << "Expected string or array value in for statement iterable" << std::endl;
-            exit(1);
+            error_output() << "Expected string or array value in for statement iterable" << std::endl;
+            error_exit();
         }
 
-        if (iterable.type == MyType::MYARRAY)
+        if (iterable.type == MyType::MYARRAY && iterable.array->lazy)
         {
-            for (auto &element : iterable.array->elements)
+            // a range is a counting loop; the count is copied in case the body writes to it
+            int count = iterable.array->count;
+            for (int i = 0; i < count; i++)
             {
-                try
-                {
-                    in_new_scope([&]()
-                                 {
-                                     env.set(stmt->identifier, element);
-                                     stmt->block->accept(this); });
-                }
-                catch (BreakException e)
+                in_new_scope([&]()
+                             {
+                                 env.define(stmt->slot, Value(iterable.array->at(i)));
+                                 execute(stmt->block); });
+                if (loop_should_exit())
                 {
                     break;
                 }
-                catch (ContinueException e)
+            }
+        }
+        else if (iterable.type == MyType::MYARRAY)
+        {
+            for (auto &element : iterable.array->elements)
+            {
+                in_new_scope([&]()
+                             {
+                                 env.define(stmt->slot, element);
+                                 execute(stmt->block); });
+                if (loop_should_exit())
                 {
-                    continue;
+                    break;
                 }
             }
         }
         else
         {
-            for (auto &c : iterable.string_value)
+            for (auto &c : iterable.str())
             {
-                try
-                {
-                    in_new_scope([&]()
-                                 { 
-                                    env.set(stmt->identifier, Value(std::string(1, c)));
-                                    stmt->block->accept(this); });
-                }
-                catch (BreakException e)
+                in_new_scope([&]()
+                             {
+                                 env.define(stmt->slot, Value(std::string(1, c)));
+                                 execute(stmt->block); });
+                if (loop_should_exit())
                 {
                     break;
                 }
-                catch (ContinueException e)
-                {
-                    continue;
-                }
             }
         }
     }
 
     virtual void visit(ReturnStmt *stmt) override
     {
-        if (stmt->is_void)
+        auto call = (CallExpr *)stmt->expr;
+        if (stmt->tail_call && call->depth >= 0)
+        {
+            tail_args = call_args(call);
+            Value holder;
+            tail_callee = Value(callee(call, holder));
+            tail_calling = true;
+        }
+        else if (stmt->is_void)
         {
             // do nothing
         }
@@ -235,34 +290,40 @@ struct Interpreter : Visitor
             stmt->expr->accept(this);
         }
 
-        throw ReturnException();
+        completion = RETURNING;
     }
 
     virtual void visit(BreakStmt *stmt) override
     {
-        throw BreakException();
+        completion = BREAKING;
     }
 
     virtual void visit(ContinueStmt *stmt) override
     {
-        throw ContinueException();
+        completion = CONTINUING;
     }
 
     virtual void visit(FnDecl *stmt) override
     {
-        auto callable = new Callable(stmt);
-        env.set(stmt->identifier, callable);
+        auto callable = new Callable(stmt, env.frame);
+        env.define(stmt->slot, callable);
     }
 
     virtual void visit(VarDecl *stmt) override
     {
         stmt->value->accept(this);
-        env.set(stmt->identifier, stack.pop());
+        env.define(stmt->slot, stack.pop());
     }
 
     virtual void visit(ExprStmt *stmt) override
     {
+        // the value is dropped. a call to a function without one pushes nothing
+        auto depth = stack.stack.size();
         stmt->expr->accept(this);
+        while (stack.stack.size() > depth)
+        {
+            stack.pop();
+        }
     }
 
     virtual void visit(BlockStmt *stmt) override
@@ -271,54 +332,49 @@ struct Interpreter : Visitor
                      {
                     for (int i = 0; i < stmt->stmts.size(); i++)
                     {
-                        auto &s = stmt->stmts[stmt->stmts.size() - i - 1];
-                        s->accept(this);
+                        auto s = stmt->stmts[stmt->stmts.size() - i - 1];
+                        if (execute(s) != COMPLETE)
+                        {
+                            break;
+                        }
                     } });
     }
 
     virtual void visit(LambdaExpr *expr) override
     {
-        auto callable = new Callable(expr);
+        auto callable = new Callable(expr, env.frame);
         stack.push(Value(callable));
     }
 
     virtual void visit(AssignExpr *expr) override
     {
-        if (!env.contains(expr->identifier))
-        {
-            std::cerr << "Variable " << expr->identifier << " not defined" << std::endl;
-            exit(1);
-        }
-
+        // an assignment is an expression, worth the value assigned, as in the VM
         expr->value->accept(this);
-        env.set(expr->identifier, stack.pop());
+        auto value = stack.pop();
+        env.set(expr->depth, expr->slot, value);
+        stack.push(value);
     }
 
     virtual void visit(ArrayAssignExpr *expr) override
     {
-        if (!env.contains(expr->identifier))
-        {
-            std::cerr << "Variable " << expr->identifier << " not defined" << std::endl;
-            exit(1);
-        }
-
         expr->index->accept(this);
         auto index = stack.pop();
 
         expr->value->accept(this);
         auto value = stack.pop();
 
-        auto array_value = env.get(expr->identifier);
+        auto array_value = env.get(expr->depth, expr->slot);
         auto array = array_value.array;
 
         if (index.type == MyType::MYINT)
         {
             array->set(index, value);
+            stack.push(value);
         }
         else
         {
-            std::cerr << "Array index must be an integer" << std::endl;
-            exit(1);
+            error_output() << "Array index must be an integer" << std::endl;
+            error_exit();
         }
     }
 
@@ -329,8 +385,8 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in ternary expression condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in ternary expression condition" << std::endl;
+            error_exit();
         }
 
         if (condition.bool_value)
@@ -348,66 +404,18 @@ struct Interpreter : Visitor
         expr->left->accept(this);
         auto left = stack.pop();
 
-        expr->right->accept(this);
-        auto right = stack.pop();
-
-        if (left.type != right.type)
+        // and/or skip the right operand once the left one decides the result
+        if ((expr->op == BINARY_AND || expr->op == BINARY_OR) && left.type == MyType::MYBOOL &&
+            left.bool_value == (expr->op == BINARY_OR))
         {
-            std::cerr << "Binary operation between different types" << std::endl;
-            exit(1);
+            stack.push(left);
+            return;
         }
 
-        auto op = expr->op;
+        expr->right->accept(this);
+        auto right = stack.pop();
 
-        if (op == "+")
-        {
-            stack.push(Value(left + right));
-        }
-        else if (op == "-")
-        {
-            stack.push(Value(left - right));
-        }
-        else if (op == "*")
-        {
-            stack.push(Value(left * right));
-        }
-        else if (op == "/")
-        {
-            stack.push(Value(left / right));
-        }
-        else if (op == "%")
-        {
-            stack.push(Value(left % right));
-        }
-        else if (op == "==")
-        {
-            stack.push(Value(left == right));
-        }
-        else if (op == "!=")
-        {
-            stack.push(Value(left != right));
-        }
-        else if (op == "<")
-        {
-            stack.push(Value(left < right));
-        }
-        else if (op == "<=")
-        {
-            stack.push(Value(left <= right));
-        }
-        else if (op == ">")
-        {
-            stack.push(Value(left > right));
-        }
-        else if (op == ">=")
-        {
-            stack.push(Value(left >= right));
-        }
-        else
-        {
-            std::cerr << "Unknown binary operator" << std::endl;
-            exit(1);
-        }
+        stack.push(Value::binary(expr->op, left, right));
     }
 
     virtual void visit(UnaryExpr *expr) override
@@ -415,64 +423,82 @@ struct Interpreter : Visitor
         expr->expr->accept(this);
         auto value = stack.pop();
 
-        if (expr->op == "-")
-        {
-            stack.push(-value);
-        }
-        else if (expr->op == "not")
-        {
-            stack.push(!value);
-        }
-        else
-        {
-            std::cerr << "Unknown unary operator" << std::endl;
-            exit(1);
-        }
+        stack.push(Value::unary(expr->op, value));
     }
 
-    virtual void visit(CallExpr *expr) override
+    std::vector<Value> call_args(CallExpr *expr)
     {
-
         std::vector<Value> args;
         for (auto it = expr->args.rbegin(); it != expr->args.rend(); ++it)
         {
-            it->get()->accept(this);
+            (*it)->accept(this);
             args.push_back(stack.pop());
         }
+        return args;
+    }
 
-        if (!env.contains(expr->identifier))
+    virtual void visit(CallExpr *expr) override
+    {
+        auto args = call_args(expr);
+
+        if (expr->native != nullptr)
         {
-            if (expr->identifier == "print")
+            auto result = expr->native->function(args);
+            if (expr->native->result != RESULT_NONE)
             {
-                StandardLib::print(args);
-            }
-            else if (expr->identifier == "range")
-            {
-                auto result = StandardLib::range(args);
                 stack.push(result);
             }
-            else
-            {
-                throw std::runtime_error("Function " + expr->identifier + " not defined");
-            }
             return;
         }
 
-        auto callable = env.get(expr->identifier).callable;
-        callable->call(this, args);
+        // holding the Value keeps the function alive even if the call reassigns its variable
+        Value holder;
+        callee(expr, holder)->call(this, args);
     }
 
-    virtual void visit(ArrayAccessExpr *expr) override
+    // the function expr calls. on a cache miss holder takes a reference, which the caller
+    // keeps for the length of the call
+    Callable *callee(CallExpr *expr, Value &holder)
     {
-        if (!env.contains(expr->identifier))
+        auto value = env.find(expr->depth, expr->slot);
+        if (value == nullptr || value->type != MyType::MYFUNCTION)
+        {
+            error_output() << "Cannot call " << expr->identifier << ", which is not a function" << std::endl;
+            error_exit();
+        }
+
+        auto callable = value->callable;
+        // a function passed in from another program has sites numbered for that program. the
+        // guard below keeps a collision correct, this only keeps the index in bounds
+        if ((size_t)expr->site >= call_sites.size())
+        {
+            holder = *value;
+            return callable;
+        }
+
+        auto &site = call_sites[expr->site];
+        if (site.callable == callable)
+        {
+            return callable;
+        }
+        if (site.callable == nullptr && !site.megamorphic)
         {
-            std::cerr << "Variable " << expr->identifier << " not defined" << std::endl;
-            exit(1);
+            callable->retain();
+            site.callable = callable;
+            return callable;
         }
+
+        site.megamorphic = true;
+        holder = *value;
+        return callable;
+    }
+
+    virtual void visit(ArrayAccessExpr *expr) override
+    {
         expr->index->accept(this);
         auto index = stack.pop();
 
-        auto array_value = env.get(expr->identifier);
+        auto array_value = env.get(expr->depth, expr->slot);
         auto array = array_value.array;
 
         if (index.type == MyType::MYINT)
@@ -481,8 +507,8 @@ struct Interpreter : Visitor
         }
         else
         {
-            std::cerr << "Array index must be an integer" << std::endl;
-            exit(1);
+            error_output() << "Array index must be an integer" << std::endl;
+            error_exit();
         }
     }
 
@@ -513,13 +539,7 @@ struct Interpreter : Visitor
 
     virtual void visit(IdentifierExpr *expr) override
     {
-        if (!env.contains(expr->identifier))
-        {
-            std::cerr << "Variable " << expr->identifier << " not defined" << std::endl;
-            exit(1);
-        }
-
-        stack.push(env.get(expr->identifier));
+        stack.push(env.get(expr->depth, expr->slot));
     }
 
     virtual void visit(ArrayLiteral *expr) override
@@ -527,7 +547,7 @@ struct Interpreter : Visitor
         std::vector<Value> elements;
         for (auto it = expr->elements.rbegin(); it != expr->elements.rend(); ++it)
         {
-            it->get()->accept(this);
+            (*it)->accept(this);
             elements.push_back(std::move(stack.pop()));
         }
 
@@ -535,119 +555,128 @@ struct Interpreter : Visitor
         stack.push(Value(array));
     }
 
-    void unwrap_pseudo_or_add(std::shared_ptr<DHTT::Node> dest, std::shared_ptr<DHTT::Node> result)
+    // children are stored last to first. with --jobs, a run of sibling loads is evaluated together
+    void add_children(NodeList<TreeNode> &children)
     {
-        if (auto pseudo = dynamic_cast<DHTT::Pseudo *>(result.get()))
+        for (int i = children.size() - 1; i >= 0; i--)
         {
-            for (auto &child : pseudo->children)
+            int run = 0;
+            while (load_jobs() > 1 && i - run >= 0 && dynamic_cast<AtLoadNode *>(children[i - run]))
             {
-                dest->add(std::move(child));
+                run++;
             }
-        }
-        else
-        {
-            dest->add(std::move(result));
+
+            if (run > 1)
+            {
+                add_loads(children, i, run);
+                i -= run - 1;
+                continue;
+            }
+
+            children[i]->accept(this);
         }
     }
 
-    virtual void visit(AndNode *node) override
+    // the args are evaluated in turn, and anything they print is held back so it comes out
+    // between the output of the loads around it. a load that shares state is evaluated before
+    // the args after it, so the run ends there
+    void add_loads(NodeList<TreeNode> &children, int first, int run)
     {
-        auto and_node = std::shared_ptr<DHTT::Node>(new DHTT::And());
-        current_root = and_node;
-        for (int i = 0; i < node->children.size(); i++)
+        auto saved = StandardLib::output();
+        std::ostringstream between;
+        std::vector<LoadJob> loads;
+        for (int k = 0; k < run; k++)
         {
-            node->children[node->children.size() - i - 1]->accept(this);
-            auto result = std::move(node_stack.pop());
-            unwrap_pseudo_or_add(and_node, result);
+            auto args = load_args((AtLoadNode *)children[first - k]);
+            loads.push_back(LoadJob{args[0].str(), std::vector<Value>(args.begin() + 1, args.end()), between.str()});
+            between.str("");
+            if (k + 1 < run && !shares_state(loads.back().inputs))
+            {
+                StandardLib::output() = &between;
+                continue;
+            }
+            StandardLib::output() = saved;
+
+            run_loads(loads, evaluate_load);
+
+            // the same as visiting each load in turn
+            for (auto &load : loads)
+            {
+                tree.splice(*load.tree);
+            }
+            loads.clear();
         }
+    }
 
-        node_stack.push(std::move(and_node));
+    virtual void visit(AndNode *node) override
+    {
+        tree.open(DHTT::AND);
+        add_children(node->children);
+        tree.close();
     }
 
     virtual void visit(OrNode *node) override
     {
-        auto or_node = std::shared_ptr<DHTT::Node>(new DHTT::Or());
-        current_root = or_node;
-        for (int i = 0; i < node->children.size(); i++)
-        {
-            node->children[node->children.size() - i - 1]->accept(this);
-            auto result = std::move(node_stack.pop());
-            unwrap_pseudo_or_add(or_node, result);
-        }
-        node_stack.push(std::move(or_node));
+        tree.open(DHTT::OR);
+        add_children(node->children);
+        tree.close();
     }
 
     virtual void visit(ThenNode *node) override
     {
-
-        auto then_node = std::shared_ptr<DHTT::Node>(new DHTT::Then());
-        current_root = then_node;
-        for (int i = 0; i < node->children.size(); i++)
-        {
-            node->children[node->children.size() - i - 1]->accept(this);
-            auto result = std::move(node_stack.pop());
-            unwrap_pseudo_or_add(then_node, result);
-        }
-
-        node_stack.push(std::move(then_node));
+        tree.open(DHTT::THEN);
+        add_children(node->children);
+        tree.close();
     }
 
     virtual void visit(BehaviorNode *node) override
     {
-        std::vector<std::string> args;
+        // the args are evaluated before any of the behavior's strings are added
+        std::vector<Value> args;
         for (auto &arg : node->args)
         {
             arg->accept(this);
-            args.push_back(stack.pop().to_string());
+            args.push_back(stack.pop());
         }
 
-        auto behavior_node = std::shared_ptr<DHTT::Node>(new DHTT::Behavior(node->identifier, args));
-        node_stack.push(std::move(behavior_node));
+        tree.add_string(node->identifier);
+        for (auto &arg : args)
+        {
+            tree.add_string(arg.to_string());
+        }
+        tree.end_behavior();
     }
 
-    virtual void visit(AtLoadNode *at_load) override
+    // each loaded program gets an Interpreter of its own
+    static LoadedTree evaluate_load(Program *program, std::vector<Value> inputs)
+    {
+        Interpreter interpreter;
+        interpreter.evaluate(program, inputs);
+        return std::make_shared<const DHTT::Tree>(std::move(interpreter.tree));
+    }
+
+    std::vector<Value> load_args(AtLoadNode *at_load)
     {
         std::vector<Value> args;
         for (auto it = at_load->args.rbegin(); it != at_load->args.rend(); ++it)
         {
-            it->get()->accept(this);
+            (*it)->accept(this);
             args.push_back(stack.pop());
         }
 
         if (args.size() < 1 || args[0].type != MyType::MYSTRING)
         {
-            std::cerr << "Expected string value as first argument to load" << std::endl;
-            exit(1);
-        }
-
-        std::ifstream file(args[0].string_value);
-        if (!file.is_open())
-        {
-            std::cerr << "Could not open file: " << args[0].string_value << std::endl;
-            exit(1);
-        }
-
-        std::string source;
-        std::string line;
-        while (getline(file, line))
-        {
-            source += line + '\n';
+            error_output() << "Expected string value as first argument to load" << std::endl;
+            error_exit();
         }
+        return args;
+    }
 
-        file.close();
-
-        Program *root = nullptr;
-        ros_parse(&root, source.c_str());
-
-        Interpreter interpreter;
-        interpreter.evaluate(root, std::vector<Value>(args.begin() + 1, args.end()));
-
-        auto tree = interpreter.roots;
-
-        for (auto &child : tree)
-        {
-            node_stack.push(std::move(child));
-        }
+    virtual void visit(AtLoadNode *at_load) override
+    {
+        auto args = load_args(at_load);
+        auto loaded = load_tree(args[0].str(), std::vector<Value>(args.begin() + 1, args.end()), evaluate_load);
+        tree.splice(*loaded);
     }
 
     virtual void visit(AtIfNode *at_if) override
@@ -657,22 +686,16 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in if statement condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in if statement condition" << std::endl;
+            error_exit();
         }
 
-        auto pseudo_node = std::shared_ptr<DHTT::Node>(new DHTT::Pseudo());
+        tree.open(DHTT::PSEUDO);
         if (condition.bool_value)
         {
-            for (int i = 0; i < at_if->children.size(); i++)
-            {
-                at_if->children[at_if->children.size() - i - 1]->accept(this);
-                auto result = std::move(node_stack.pop());
-                unwrap_pseudo_or_add(pseudo_node, result);
-            }
+            add_children(at_if->children);
         }
-
-        node_stack.push(std::move(pseudo_node));
+        tree.close();
     }
 
     virtual void visit(AtIfElseNode *at_if_else) override
@@ -682,31 +705,20 @@ struct Interpreter : Visitor
 
         if (condition.type != MyType::MYBOOL)
         {
-            std::cerr << "Expected boolean value in if statement condition" << std::endl;
-            exit(1);
+            error_output() << "Expected boolean value in if statement condition" << std::endl;
+            error_exit();
         }
 
-        auto pseudo_node = std::shared_ptr<DHTT::Node>(new DHTT::Pseudo());
+        tree.open(DHTT::PSEUDO);
         if (condition.bool_value)
         {
-            for (int i = 0; i < at_if_else->then_children.size(); i++)
-            {
-                at_if_else->then_children[at_if_else->then_children.size() - 1 - i]->accept(this);
-                auto result = std::move(node_stack.pop());
-                unwrap_pseudo_or_add(pseudo_node, result);
-            }
+            add_children(at_if_else->then_children);
         }
         else
         {
-            for (int i = 0; i < at_if_else->else_children.size(); i++)
-            {
-                at_if_else->else_children[at_if_else->else_children.size() - 1 - i]->accept(this);
-                auto result = std::move(node_stack.pop());
-                unwrap_pseudo_or_add(pseudo_node, result);
-            }
+            add_children(at_if_else->else_children);
         }
-
-        node_stack.push(std::move(pseudo_node));
+        tree.close();
     }
 
     virtual void visit(AtForNode *at_for) override
@@ -716,63 +728,63 @@ struct Interpreter : Visitor
 
         if (iterable.type != MyType::MYSTRING && iterable.type != MyType::MYARRAY)
         {
-            std::cerr << "Expected string or array value in for statement iterable" << std::endl;
-            exit(1);
+            error_output() << "Expected string or array value in for statement iterable" << std::endl;
+            error_exit();
         }
 
-        auto pseudo_node = std::shared_ptr<DHTT::Node>(new DHTT::Pseudo());
-        if (iterable.type == MyType::MYARRAY)
+        tree.open(DHTT::PSEUDO);
+        if (iterable.type == MyType::MYARRAY && iterable.array->lazy)
+        {
+            int count = iterable.array->count;
+            for (int i = 0; i < count; i++)
+            {
+                in_new_scope([&]()
+                             {
+                env.define(at_for->slot, Value(iterable.array->at(i)));
+                for (auto &child : at_for->children)
+                {
+                    child->accept(this);
+                } });
+            }
+        }
+        else if (iterable.type == MyType::MYARRAY)
         {
             for (auto &element : iterable.array->elements)
             {
                 in_new_scope([&]()
                              {
-                env.set(at_for->identifier, element);
+                env.define(at_for->slot, element);
                 for (auto &child : at_for->children)
                 {
                     child->accept(this);
-                    auto result = std::move(node_stack.pop());
-                    unwrap_pseudo_or_add(pseudo_node, result);
                 } });
             }
         }
         else
         {
-            for (auto &c : iterable.string_value)
+            for (auto &c : iterable.str())
             {
                 in_new_scope([&]()
                              {
-                env.set(at_for->identifier, Value(std::string(1, c)));
+                env.define(at_for->slot, Value(std::string(1, c)));
                 for (auto &child : at_for->children)
                 {
                     child->accept(this);
-                    auto result = std::move(node_stack.pop());
-                    if (auto pseudo = dynamic_cast<DHTT::Pseudo *>(result.get()))
-                    {
-                        for (auto &child : pseudo->children)
-                        {
-                            pseudo_node->add(std::move(child));
-                        }
-                    }
-                    else
-                    {
-                        pseudo_node->add(std::move(result));
-                    }
                 } });
             }
         }
 
-        node_stack.push(std::move(pseudo_node));
+        tree.close();
     }
 
     virtual void visit(InputDefault *input) override
     {
         input->value->accept(this);
-        env.set(input->identifier, Value(stack.pop()));
+        env.define(input->slot, Value(stack.pop()));
     }
 
     virtual void visit(Input *input) override
     {
-        env.set(input->identifier, Value());
+        env.define(input->slot, Value());
     }
 };
@@ -0,0 +1,577 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ast_nodes/ast.hpp"
+#include "value/value.hpp"
+#include "visitors/visitor.hpp"
+
+// -O1: folds operations on literals and prunes the branches a constant condition rules out.
+// a let (or a default input of the main program) that is declared once and never assigned is
+// a constant, so its uses become its value. runs before the Resolver, so it works on names
+struct Optimizer : Visitor
+{
+    Arena *arena = nullptr;
+    bool fold_inputs = false;
+
+    // the first walk counts declarations and assignments, the second one replaces constants
+    bool propagate = false;
+    std::unordered_map<std::string, int> declarations;
+    std::unordered_map<std::string, int> assignments;
+    std::vector<std::unordered_map<std::string, Expr *>> scopes; // constants in scope
+
+    // results of the node just visited, read and cleared by its parent
+    Expr *folded = nullptr;
+    bool stmt_replaced = false;
+    Stmt *stmt_replacement = nullptr; // nullptr removes the stmt
+    bool splice = false;
+    NodeList<TreeNode> splice_children;
+
+    void optimize(Program *program, bool fold_inputs)
+    {
+        arena = program->arena.get();
+        this->fold_inputs = fold_inputs;
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            propagate = pass == 1;
+            begin_scope();
+
+            // Input::accept is not overridden, so defaults have to be picked out by hand
+            for (auto &input : program->inputs)
+            {
+                if (auto default_input = dynamic_cast<InputDefault *>(input))
+                {
+                    visit(default_input);
+                }
+                else
+                {
+                    visit(input);
+                }
+            }
+            optimize_stmts(program->stmts);
+
+            // the root has no parent to be spliced into
+            program->treeNode->accept(this);
+            splice = false;
+
+            end_scope();
+        }
+    }
+
+    void begin_scope()
+    {
+        scopes.push_back(std::unordered_map<std::string, Expr *>());
+    }
+
+    void end_scope()
+    {
+        scopes.pop_back();
+    }
+
+    void declare(const std::string &identifier, Expr *value)
+    {
+        if (!propagate)
+        {
+            declarations[identifier]++;
+            return;
+        }
+
+        if (value != nullptr && is_literal(value) && declarations[identifier] == 1 &&
+            assignments.find(identifier) == assignments.end())
+        {
+            scopes.back()[identifier] = value;
+        }
+    }
+
+    void assign(const std::string &identifier)
+    {
+        if (!propagate)
+        {
+            assignments[identifier]++;
+        }
+    }
+
+    bool is_literal(Expr *expr)
+    {
+        return dynamic_cast<IntLiteral *>(expr) || dynamic_cast<FloatLiteral *>(expr) ||
+               dynamic_cast<StringLiteral *>(expr) || dynamic_cast<BoolLiteral *>(expr);
+    }
+
+    Value value_of(Expr *literal)
+    {
+        if (auto int_literal = dynamic_cast<IntLiteral *>(literal))
+        {
+            return Value(int_literal->value);
+        }
+        if (auto float_literal = dynamic_cast<FloatLiteral *>(literal))
+        {
+            return Value(float_literal->value);
+        }
+        if (auto string_literal = dynamic_cast<StringLiteral *>(literal))
+        {
+            return Value(string_literal->value);
+        }
+        return Value(dynamic_cast<BoolLiteral *>(literal)->value);
+    }
+
+    Expr *literal(const Value &value)
+    {
+        switch (value.type)
+        {
+        case MyType::MYINT:
+            return arena->make<IntLiteral>(value.int_value);
+        case MyType::MYFLOAT:
+            return arena->make<FloatLiteral>(value.float_value);
+        case MyType::MYSTRING:
+            return arena->make<StringLiteral>(String::intern(value.str()));
+        default:
+            return arena->make<BoolLiteral>(value.bool_value);
+        }
+    }
+
+    // a literal bool condition, the only kind the evaluator accepts without an error
+    bool constant_condition(Expr *condition, bool &value)
+    {
+        auto bool_literal = dynamic_cast<BoolLiteral *>(condition);
+        if (bool_literal == nullptr)
+        {
+            return false;
+        }
+
+        value = bool_literal->value;
+        return true;
+    }
+
+    Expr *fold(Expr *expr)
+    {
+        expr->accept(this);
+
+        auto result = folded != nullptr ? folded : expr;
+        folded = nullptr;
+        return result;
+    }
+
+    void fold_all(NodeList<Expr> &exprs)
+    {
+        for (auto &expr : exprs)
+        {
+            expr = fold(expr);
+        }
+    }
+
+    Stmt *optimize_stmt(Stmt *stmt)
+    {
+        stmt->accept(this);
+
+        // expression statements keep their root, there is nothing to gain from folding it
+        folded = nullptr;
+
+        if (stmt_replaced)
+        {
+            stmt_replaced = false;
+            return stmt_replacement;
+        }
+        return stmt;
+    }
+
+    void optimize_stmts(NodeList<Stmt> &stmts)
+    {
+        // stmts are stored last to first, but have to be visited in the order they run
+        std::vector<Stmt *> kept;
+        for (int i = stmts.size() - 1; i >= 0; i--)
+        {
+            auto stmt = optimize_stmt(stmts[i]);
+            if (stmt != nullptr)
+            {
+                kept.push_back(stmt);
+            }
+        }
+
+        stmts.count = kept.size();
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            stmts.items[i] = kept[kept.size() - 1 - i];
+        }
+    }
+
+    // the evaluator unwraps an @if into its parent, so a constant one is replaced by the children
+    // it would build. they run last to first, so a parent that runs first to last takes them reversed
+    void optimize_children(NodeList<TreeNode> &children, bool forward)
+    {
+        std::vector<TreeNode *> kept;
+        for (auto &child : children)
+        {
+            child->accept(this);
+            if (!splice)
+            {
+                kept.push_back(child);
+            }
+            else if (forward)
+            {
+                kept.insert(kept.end(), splice_children.rbegin(), splice_children.rend());
+            }
+            else
+            {
+                kept.insert(kept.end(), splice_children.begin(), splice_children.end());
+            }
+            splice = false;
+        }
+
+        if (kept.size() > children.size())
+        {
+            children.items = (TreeNode **)arena->allocate(sizeof(TreeNode *) * kept.size(), alignof(TreeNode *));
+        }
+        children.count = kept.size();
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            children.items[i] = kept[i];
+        }
+    }
+
+    void remove_stmt()
+    {
+        stmt_replaced = true;
+        stmt_replacement = nullptr;
+    }
+
+    void replace_stmt(Stmt *stmt)
+    {
+        stmt_replaced = true;
+        stmt_replacement = stmt;
+    }
+
+    void optimize_function(NodeList<IdentifierType> &params, BlockStmt *block, Expr *&expr)
+    {
+        begin_scope();
+        for (auto &param : params)
+        {
+            declare(param->identifier, nullptr);
+        }
+
+        if (block != nullptr)
+        {
+            block->accept(this);
+        }
+        else
+        {
+            expr = fold(expr);
+        }
+        end_scope();
+    }
+
+    virtual void visit(IfStmt *stmt) override
+    {
+        stmt->condition = fold(stmt->condition);
+
+        bool condition;
+        if (!constant_condition(stmt->condition, condition))
+        {
+            stmt->then_block->accept(this);
+        }
+        else if (condition)
+        {
+            stmt->then_block->accept(this);
+            replace_stmt(stmt->then_block);
+        }
+        else
+        {
+            remove_stmt();
+        }
+    }
+
+    virtual void visit(IfElseStmt *stmt) override
+    {
+        stmt->condition = fold(stmt->condition);
+
+        bool condition;
+        if (!constant_condition(stmt->condition, condition))
+        {
+            stmt->then_block->accept(this);
+            stmt->else_block->accept(this);
+            return;
+        }
+
+        auto block = condition ? stmt->then_block : stmt->else_block;
+        block->accept(this);
+        replace_stmt(block);
+    }
+
+    virtual void visit(WhileStmt *stmt) override
+    {
+        stmt->condition = fold(stmt->condition);
+
+        bool condition;
+        if (constant_condition(stmt->condition, condition) && !condition)
+        {
+            remove_stmt();
+            return;
+        }
+
+        stmt->block->accept(this);
+    }
+
+    virtual void visit(ForInStmt *stmt) override
+    {
+        stmt->iterable = fold(stmt->iterable);
+
+        begin_scope();
+        declare(stmt->identifier, nullptr);
+        stmt->block->accept(this);
+        end_scope();
+    }
+
+    virtual void visit(ReturnStmt *stmt) override
+    {
+        if (!stmt->is_void)
+        {
+            stmt->expr = fold(stmt->expr);
+        }
+    }
+
+    virtual void visit(BreakStmt *stmt) override
+    {
+    }
+
+    virtual void visit(ContinueStmt *stmt) override
+    {
+    }
+
+    virtual void visit(FnDecl *stmt) override
+    {
+        declare(stmt->identifier, nullptr);
+
+        Expr *no_expr = nullptr;
+        optimize_function(stmt->params, stmt->block, no_expr);
+    }
+
+    virtual void visit(VarDecl *stmt) override
+    {
+        stmt->value = fold(stmt->value);
+        declare(stmt->identifier, stmt->value);
+    }
+
+    virtual void visit(ExprStmt *stmt) override
+    {
+        stmt->expr = fold(stmt->expr);
+    }
+
+    virtual void visit(BlockStmt *stmt) override
+    {
+        begin_scope();
+        optimize_stmts(stmt->stmts);
+        end_scope();
+    }
+
+    virtual void visit(LambdaExpr *expr) override
+    {
+        optimize_function(expr->params, nullptr, expr->expr);
+    }
+
+    virtual void visit(AssignExpr *expr) override
+    {
+        expr->value = fold(expr->value);
+        assign(expr->identifier);
+    }
+
+    virtual void visit(ArrayAssignExpr *expr) override
+    {
+        expr->index = fold(expr->index);
+        expr->value = fold(expr->value);
+        assign(expr->identifier);
+    }
+
+    virtual void visit(TernaryExpr *expr) override
+    {
+        expr->condition = fold(expr->condition);
+        expr->then_expr = fold(expr->then_expr);
+        expr->else_expr = fold(expr->else_expr);
+
+        bool condition;
+        if (constant_condition(expr->condition, condition))
+        {
+            folded = condition ? expr->then_expr : expr->else_expr;
+        }
+    }
+
+    virtual void visit(BinaryExpr *expr) override
+    {
+        expr->left = fold(expr->left);
+        expr->right = fold(expr->right);
+
+        if (!is_literal(expr->left))
+        {
+            return;
+        }
+        auto left = value_of(expr->left);
+
+        // and/or stop at a left operand that decides the result, whatever the right one is
+        if ((expr->op == BINARY_AND || expr->op == BINARY_OR) && left.type == MyType::MYBOOL &&
+            left.bool_value == (expr->op == BINARY_OR))
+        {
+            folded = expr->left;
+            return;
+        }
+
+        if (!is_literal(expr->right))
+        {
+            return;
+        }
+        auto right = value_of(expr->right);
+
+        // errors are left for the evaluator to report, in case the expr never runs
+        if (!Value::binary_defined(expr->op, left.type, right.type))
+        {
+            return;
+        }
+        if ((expr->op == BINARY_DIV || expr->op == BINARY_MOD) && right.type == MyType::MYINT && right.int_value == 0)
+        {
+            return;
+        }
+
+        folded = literal(Value::binary(expr->op, left, right));
+    }
+
+    virtual void visit(UnaryExpr *expr) override
+    {
+        expr->expr = fold(expr->expr);
+
+        if (!is_literal(expr->expr))
+        {
+            return;
+        }
+        auto value = value_of(expr->expr);
+
+        if (Value::unary_defined(expr->op, value.type))
+        {
+            folded = literal(Value::unary(expr->op, value));
+        }
+    }
+
+    virtual void visit(CallExpr *expr) override
+    {
+        fold_all(expr->args);
+    }
+
+    virtual void visit(ArrayAccessExpr *expr) override
+    {
+        expr->index = fold(expr->index);
+    }
+
+    virtual void visit(IntLiteral *expr) override
+    {
+    }
+
+    virtual void visit(FloatLiteral *expr) override
+    {
+    }
+
+    virtual void visit(StringLiteral *expr) override
+    {
+    }
+
+    virtual void visit(NoneLiteral *expr) override
+    {
+    }
+
+    virtual void visit(BoolLiteral *expr) override
+    {
+    }
+
+    virtual void visit(IdentifierExpr *expr) override
+    {
+        if (!propagate)
+        {
+            return;
+        }
+
+        for (int i = scopes.size() - 1; i >= 0; i--)
+        {
+            auto it = scopes[i].find(expr->identifier);
+            if (it != scopes[i].end())
+            {
+                folded = it->second;
+                return;
+            }
+        }
+    }
+
+    virtual void visit(ArrayLiteral *expr) override
+    {
+        fold_all(expr->elements);
+    }
+
+    virtual void visit(AndNode *node) override
+    {
+        optimize_children(node->children, false);
+    }
+
+    virtual void visit(OrNode *node) override
+    {
+        optimize_children(node->children, false);
+    }
+
+    virtual void visit(ThenNode *node) override
+    {
+        optimize_children(node->children, false);
+    }
+
+    virtual void visit(BehaviorNode *node) override
+    {
+        fold_all(node->args);
+    }
+
+    virtual void visit(AtLoadNode *at_load) override
+    {
+        fold_all(at_load->args);
+    }
+
+    virtual void visit(AtIfNode *at_if) override
+    {
+        at_if->condition = fold(at_if->condition);
+        optimize_children(at_if->children, false);
+
+        bool condition;
+        if (constant_condition(at_if->condition, condition))
+        {
+            splice = true;
+            splice_children = condition ? at_if->children : NodeList<TreeNode>();
+        }
+    }
+
+    virtual void visit(AtIfElseNode *at_if_else) override
+    {
+        at_if_else->condition = fold(at_if_else->condition);
+        optimize_children(at_if_else->then_children, false);
+        optimize_children(at_if_else->else_children, false);
+
+        bool condition;
+        if (constant_condition(at_if_else->condition, condition))
+        {
+            splice = true;
+            splice_children = condition ? at_if_else->then_children : at_if_else->else_children;
+        }
+    }
+
+    virtual void visit(AtForNode *at_for) override
+    {
+        at_for->iterable = fold(at_for->iterable);
+
+        begin_scope();
+        declare(at_for->identifier, nullptr);
+        optimize_children(at_for->children, true);
+        end_scope();
+    }
+
+    virtual void visit(InputDefault *input) override
+    {
+        input->value = fold(input->value);
+        declare(input->identifier, fold_inputs ? input->value : nullptr);
+    }
+
+    virtual void visit(Input *input) override
+    {
+        declare(input->identifier, nullptr);
+    }
+};
@@ -4,28 +4,32 @@
 
 struct Printer : Visitor
 {
+    std::ostream &out;
+
+    Printer(std::ostream &out = std::cout) : out(out) {}
+
     void print(Program *program)
     {
 
-        std::cout << "Inputs\n";
+        out << "Inputs\n";
         for (auto &input : program->inputs)
         {
             input->accept(this);
         }
 
-        std::cout << "StmtList\n";
+        out << "StmtList\n";
         for (auto &stmt : program->stmts)
         {
             stmt->accept(this);
         }
 
-        std::cout << "TreeNode\n";
+        out << "TreeNode\n";
         program->treeNode->accept(this);
     }
 
     virtual void visit(IfStmt *stmt) override
     {
-        std::cout << "IfStmt\n";
+        out << "IfStmt\n";
 
         stmt->condition->accept(this);
         stmt->then_block->accept(this);
@@ -33,7 +37,7 @@ struct Printer : Visitor
 
     virtual void visit(IfElseStmt *stmt) override
     {
-        std::cout << "IfElseStmt\n";
+        out << "IfElseStmt\n";
 
         stmt->condition->accept(this);
         stmt->then_block->accept(this);
@@ -42,7 +46,7 @@ struct Printer : Visitor
 
     virtual void visit(WhileStmt *stmt) override
     {
-        std::cout << "WhileStmt\n";
+        out << "WhileStmt\n";
 
         stmt->condition->accept(this);
         stmt->block->accept(this);
@@ -50,7 +54,7 @@ struct Printer : Visitor
 
     virtual void visit(ForInStmt *stmt) override
     {
-        std::cout << "ForInStmt\n";
+        out << "ForInStmt\n";
 
         stmt->iterable->accept(this);
         stmt->block->accept(this);
@@ -58,7 +62,7 @@ struct Printer : Visitor
 
     virtual void visit(ReturnStmt *stmt) override
     {
-        std::cout << "ReturnStmt\n";
+        out << "ReturnStmt\n";
 
         if (stmt->expr)
         {
@@ -68,38 +72,38 @@ struct Printer : Visitor
 
     virtual void visit(BreakStmt *stmt) override
     {
-        std::cout << "BreakStmt\n";
+        out << "BreakStmt\n";
     }
 
     virtual void visit(ContinueStmt *stmt) override
     {
-        std::cout << "ContinueStmt\n";
+        out << "ContinueStmt\n";
     }
 
     virtual void visit(FnDecl *stmt) override
     {
-        std::cout << "FnDecl\n";
+        out << "FnDecl\n";
 
         stmt->block->accept(this);
     }
 
     virtual void visit(VarDecl *stmt) override
     {
-        std::cout << "VarDecl\n";
+        out << "VarDecl\n";
 
         stmt->value->accept(this);
     }
 
     virtual void visit(ExprStmt *stmt) override
     {
-        std::cout << "ExprStmt\n";
+        out << "ExprStmt\n";
 
         stmt->expr->accept(this);
     }
 
     virtual void visit(BlockStmt *stmt) override
     {
-        std::cout << "BlockStmt\n";
+        out << "BlockStmt\n";
 
         for (auto &stmt : stmt->stmts)
         {
@@ -109,20 +113,20 @@ struct Printer : Visitor
 
     virtual void visit(LambdaExpr *expr) override
     {
-        std::cout << "LambdaExpr\n";
+        out << "LambdaExpr\n";
         expr->expr->accept(this);
     }
 
     virtual void visit(AssignExpr *expr) override
     {
-        std::cout << "AssignExpr\n";
+        out << "AssignExpr\n";
 
         expr->value->accept(this);
     }
 
     virtual void visit(ArrayAssignExpr *expr) override
     {
-        std::cout << "ArrayAssignExpr\n";
+        out << "ArrayAssignExpr\n";
 
         expr->index->accept(this);
         expr->value->accept(this);
@@ -130,7 +134,7 @@ struct Printer : Visitor
 
     virtual void visit(TernaryExpr *expr) override
     {
-        std::cout << "TernaryExpr\n";
+        out << "TernaryExpr\n";
 
         expr->condition->accept(this);
         expr->then_expr->accept(this);
@@ -139,7 +143,7 @@ struct Printer : Visitor
 
     virtual void visit(BinaryExpr *expr) override
     {
-        std::cout << "BinaryExpr\n";
+        out << "BinaryExpr\n";
 
         expr->left->accept(this);
         expr->right->accept(this);
@@ -147,14 +151,14 @@ struct Printer : Visitor
 
     virtual void visit(UnaryExpr *expr) override
     {
-        std::cout << "UnaryExpr\n";
+        out << "UnaryExpr\n";
 
         expr->expr->accept(this);
     }
 
     virtual void visit(CallExpr *expr) override
     {
-        std::cout << "CallExpr\n";
+        out << "CallExpr\n";
 
         for (auto &arg : expr->args)
         {
@@ -164,44 +168,44 @@ struct Printer : Visitor
 
     virtual void visit(ArrayAccessExpr *expr) override
     {
-        std::cout << "ArrayAccessExpr\n";
+        out << "ArrayAccessExpr\n";
 
         expr->index->accept(this);
     }
 
     virtual void visit(IntLiteral *expr) override
     {
-        std::cout << "IntLiteral\n";
+        out << "IntLiteral\n";
     }
 
     virtual void visit(FloatLiteral *expr) override
     {
-        std::cout << "FloatLiteral\n";
+        out << "FloatLiteral\n";
     }
 
     virtual void visit(StringLiteral *expr) override
     {
-        std::cout << "StringLiteral\n";
+        out << "StringLiteral\n";
     }
 
     virtual void visit(NoneLiteral *expr) override
     {
-        std::cout << "NoneLiteral\n";
+        out << "NoneLiteral\n";
     }
 
     virtual void visit(BoolLiteral *expr) override
     {
-        std::cout << "BoolLiteral\n";
+        out << "BoolLiteral\n";
     }
 
     virtual void visit(IdentifierExpr *expr) override
     {
-        std::cout << "IdentifierExpr\n";
+        out << "IdentifierExpr\n";
     }
 
     virtual void visit(ArrayLiteral *expr) override
     {
-        std::cout << "ArrayLiteral\n";
+        out << "ArrayLiteral\n";
 
         for (auto &element : expr->elements)
         {
@@ -211,7 +215,7 @@ struct Printer : Visitor
 
     virtual void visit(AndNode *node) override
     {
-        std::cout << "AndNode\n";
+        out << "AndNode\n";
 
         for (auto &child : node->children)
         {
@@ -221,7 +225,7 @@ struct Printer : Visitor
 
     virtual void visit(OrNode *node) override
     {
-        std::cout << "OrNode\n";
+        out << "OrNode\n";
 
         for (auto &child : node->children)
         {
@@ -231,7 +235,7 @@ struct Printer : Visitor
 
     virtual void visit(ThenNode *node) override
     {
-        std::cout << "ThenNode\n";
+        out << "ThenNode\n";
 
         for (auto &child : node->children)
         {
@@ -241,7 +245,7 @@ struct Printer : Visitor
 
     virtual void visit(BehaviorNode *node) override
     {
-        std::cout << "BehaviorNode\n";
+        out << "BehaviorNode\n";
 
         for (auto &arg : node->args)
         {
@@ -251,7 +255,7 @@ struct Printer : Visitor
 
     virtual void visit(AtLoadNode *at_load) override
     {
-        std::cout << "AtLoadNode\n";
+        out << "AtLoadNode\n";
 
         for (auto &arg : at_load->args)
         {
@@ -261,7 +265,7 @@ struct Printer : Visitor
 
     virtual void visit(AtIfNode *at_if) override
     {
-        std::cout << "AtIfNode\n";
+        out << "AtIfNode\n";
 
         at_if->condition->accept(this);
         for (auto &child : at_if->children)
@@ -272,7 +276,7 @@ struct Printer : Visitor
 
     virtual void visit(AtIfElseNode *at_if_else) override
     {
-        std::cout << "AtIfElseNode\n";
+        out << "AtIfElseNode\n";
 
         at_if_else->condition->accept(this);
         for (auto &child : at_if_else->then_children)
@@ -287,7 +291,7 @@ struct Printer : Visitor
 
     virtual void visit(AtForNode *at_for) override
     {
-        std::cout << "AtForNode\n";
+        out << "AtForNode\n";
 
         at_for->iterable->accept(this);
         for (auto &child : at_for->children)
@@ -298,13 +302,13 @@ struct Printer : Visitor
 
     virtual void visit(InputDefault *input) override
     {
-        std::cout << "DefaultInput\n";
+        out << "DefaultInput\n";
 
         input->value->accept(this);
     }
 
     virtual void visit(Input *input) override
     {
-        std::cout << "Input\n";
+        out << "Input\n";
     }
 };
\ No newline at end of file
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast_nodes/ast.hpp"
+#include "error_exit.hpp"
+#include "standard_lib.hpp"
+#include "visitors/visitor.hpp"
+
+// annotates every variable reference with the (depth, slot) of the scope that declares it.
+// the scopes mirror the frames the Interpreter pushes at run time.
+struct Resolver : Visitor
+{
+    std::vector<std::unordered_map<std::string, int>> scopes;
+    std::unordered_set<std::string> defined_globals; // top level names declared so far
+    int function_depth = 0;
+    int call_sites = 0;
+
+    void resolve(Program *program)
+    {
+        scopes.push_back(std::unordered_map<std::string, int>());
+
+        // functions can refer to any top level name, even one declared further down
+        for (auto &input : program->inputs)
+        {
+            declare(input->identifier);
+        }
+        for (auto &stmt : program->stmts)
+        {
+            if (auto var_decl = dynamic_cast<VarDecl *>(stmt))
+            {
+                declare(var_decl->identifier);
+            }
+            else if (auto fn_decl = dynamic_cast<FnDecl *>(stmt))
+            {
+                declare(fn_decl->identifier);
+            }
+        }
+
+        for (auto &input : program->inputs)
+        {
+            if (auto default_input = dynamic_cast<InputDefault *>(input))
+            {
+                default_input->value->accept(this);
+            }
+            input->slot = declare(input->identifier);
+            mark_defined(input->identifier);
+        }
+
+        for (int i = 0; i < program->stmts.size(); i++)
+        {
+            program->stmts[program->stmts.size() - 1 - i]->accept(this);
+        }
+
+        program->treeNode->accept(this);
+        program->call_sites = call_sites;
+
+        scopes.pop_back();
+    }
+
+    void begin_scope()
+    {
+        scopes.push_back(std::unordered_map<std::string, int>());
+    }
+
+    void end_scope()
+    {
+        scopes.pop_back();
+    }
+
+    void mark_defined(const std::string &identifier)
+    {
+        if (scopes.size() == 1)
+        {
+            defined_globals.insert(identifier);
+        }
+    }
+
+    int declare(const std::string &identifier)
+    {
+        auto &scope = scopes.back();
+        auto it = scope.find(identifier);
+        if (it != scope.end())
+        {
+            return it->second;
+        }
+
+        int slot = scope.size();
+        scope[identifier] = slot;
+        return slot;
+    }
+
+    bool lookup(const std::string &identifier, int &depth, int &slot)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--)
+        {
+            auto it = scopes[i].find(identifier);
+            if (it == scopes[i].end())
+            {
+                continue;
+            }
+
+            // top level code runs in order, so it can only see globals that were already declared
+            if (i == 0 && function_depth == 0 && defined_globals.find(identifier) == defined_globals.end())
+            {
+                return false;
+            }
+
+            depth = scopes.size() - 1 - i;
+            slot = it->second;
+            return true;
+        }
+
+        return false;
+    }
+
+    void resolve_variable(const std::string &identifier, int &depth, int &slot)
+    {
+        if (!lookup(identifier, depth, slot))
+        {
+            error_output() << "Variable " << identifier << " not defined" << std::endl;
+            error_exit();
+        }
+    }
+
+    // the call frame holds the params, and the body runs in a block frame of its own
+    void resolve_function(NodeList<IdentifierType> &params, BlockStmt *block, Expr *expr)
+    {
+        function_depth++;
+        begin_scope();
+
+        // params are stored last to first
+        for (int i = 0; i < params.size(); i++)
+        {
+            declare(params[params.size() - 1 - i]->identifier);
+        }
+
+        if (block != nullptr)
+        {
+            block->accept(this);
+        }
+        else
+        {
+            begin_scope();
+            expr->accept(this);
+            end_scope();
+        }
+
+        end_scope();
+        function_depth--;
+    }
+
+    void resolve_children(NodeList<TreeNode> &children)
+    {
+        for (auto &child : children)
+        {
+            child->accept(this);
+        }
+    }
+
+    virtual void visit(IfStmt *stmt) override
+    {
+        stmt->condition->accept(this);
+        stmt->then_block->accept(this);
+    }
+
+    virtual void visit(IfElseStmt *stmt) override
+    {
+        stmt->condition->accept(this);
+        stmt->then_block->accept(this);
+        stmt->else_block->accept(this);
+    }
+
+    virtual void visit(WhileStmt *stmt) override
+    {
+        stmt->condition->accept(this);
+        stmt->block->accept(this);
+    }
+
+    virtual void visit(ForInStmt *stmt) override
+    {
+        stmt->iterable->accept(this);
+
+        begin_scope();
+        stmt->slot = declare(stmt->identifier);
+        stmt->block->accept(this);
+        end_scope();
+    }
+
+    virtual void visit(ReturnStmt *stmt) override
+    {
+        if (!stmt->is_void)
+        {
+            stmt->expr->accept(this);
+        }
+
+        // nothing is left to do in the function after a returned call, so its frame can be reused
+        auto call = dynamic_cast<CallExpr *>(stmt->expr);
+        stmt->tail_call = function_depth > 0 && call != nullptr && call->native == nullptr;
+    }
+
+    virtual void visit(BreakStmt *stmt) override
+    {
+    }
+
+    virtual void visit(ContinueStmt *stmt) override
+    {
+    }
+
+    virtual void visit(FnDecl *stmt) override
+    {
+        // declared first so the function can call itself
+        stmt->slot = declare(stmt->identifier);
+        mark_defined(stmt->identifier);
+        resolve_function(stmt->params, stmt->block, nullptr);
+    }
+
+    virtual void visit(VarDecl *stmt) override
+    {
+        stmt->value->accept(this);
+        stmt->slot = declare(stmt->identifier);
+        mark_defined(stmt->identifier);
+    }
+
+    virtual void visit(ExprStmt *stmt) override
+    {
+        stmt->expr->accept(this);
+    }
+
+    virtual void visit(BlockStmt *stmt) override
+    {
+        begin_scope();
+        for (int i = 0; i < stmt->stmts.size(); i++)
+        {
+            stmt->stmts[stmt->stmts.size() - i - 1]->accept(this);
+        }
+        end_scope();
+    }
+
+    virtual void visit(LambdaExpr *expr) override
+    {
+        resolve_function(expr->params, nullptr, expr->expr);
+    }
+
+    virtual void visit(AssignExpr *expr) override
+    {
+        expr->value->accept(this);
+        resolve_variable(expr->identifier, expr->depth, expr->slot);
+    }
+
+    virtual void visit(ArrayAssignExpr *expr) override
+    {
+        expr->index->accept(this);
+        expr->value->accept(this);
+        resolve_variable(expr->identifier, expr->depth, expr->slot);
+    }
+
+    virtual void visit(TernaryExpr *expr) override
+    {
+        expr->condition->accept(this);
+        expr->then_expr->accept(this);
+        expr->else_expr->accept(this);
+    }
+
+    virtual void visit(BinaryExpr *expr) override
+    {
+        expr->left->accept(this);
+        expr->right->accept(this);
+    }
+
+    virtual void visit(UnaryExpr *expr) override
+    {
+        expr->expr->accept(this);
+    }
+
+    virtual void visit(CallExpr *expr) override
+    {
+        for (auto &arg : expr->args)
+        {
+            arg->accept(this);
+        }
+
+        if (lookup(expr->identifier, expr->depth, expr->slot))
+        {
+            expr->site = call_sites++;
+            return;
+        }
+
+        // builtins keep depth -1
+        expr->native = StandardLib::native(expr->identifier);
+        if (expr->native == nullptr)
+        {
+            error_output() << "Function " << expr->identifier << " not defined" << std::endl;
+            error_exit();
+        }
+    }
+
+    virtual void visit(ArrayAccessExpr *expr) override
+    {
+        expr->index->accept(this);
+        resolve_variable(expr->identifier, expr->depth, expr->slot);
+    }
+
+    virtual void visit(IntLiteral *expr) override
+    {
+    }
+
+    virtual void visit(FloatLiteral *expr) override
+    {
+    }
+
+    virtual void visit(StringLiteral *expr) override
+    {
+    }
+
+    virtual void visit(NoneLiteral *expr) override
+    {
+    }
+
+    virtual void visit(BoolLiteral *expr) override
+    {
+    }
+
+    virtual void visit(IdentifierExpr *expr) override
+    {
+        resolve_variable(expr->identifier, expr->depth, expr->slot);
+    }
+
+    virtual void visit(ArrayLiteral *expr) override
+    {
+        for (auto &element : expr->elements)
+        {
+            element->accept(this);
+        }
+    }
+
+    virtual void visit(AndNode *node) override
+    {
+        resolve_children(node->children);
+    }
+
+    virtual void visit(OrNode *node) override
+    {
+        resolve_children(node->children);
+    }
+
+    virtual void visit(ThenNode *node) override
+    {
+        resolve_children(node->children);
+    }
+
+    virtual void visit(BehaviorNode *node) override
+    {
+        for (auto &arg : node->args)
+        {
+            arg->accept(this);
+        }
+    }
+
+    virtual void visit(AtLoadNode *at_load) override
+    {
+        for (auto &arg : at_load->args)
+        {
+            arg->accept(this);
+        }
+    }
+
+    virtual void visit(AtIfNode *at_if) override
+    {
+        at_if->condition->accept(this);
+        resolve_children(at_if->children);
+    }
+
+    virtual void visit(AtIfElseNode *at_if_else) override
+    {
+        at_if_else->condition->accept(this);
+        resolve_children(at_if_else->then_children);
+        resolve_children(at_if_else->else_children);
+    }
+
+    virtual void visit(AtForNode *at_for) override
+    {
+        at_for->iterable->accept(this);
+
+        begin_scope();
+        at_for->slot = declare(at_for->identifier);
+        resolve_children(at_for->children);
+        end_scope();
+    }
+
+    virtual void visit(InputDefault *input) override
+    {
+    }
+
+    virtual void visit(Input *input) override
+    {
+    }
+};
@@ -0,0 +1,826 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ast_nodes/ast.hpp"
+#include "error_exit.hpp"
+#include "standard_lib.hpp"
+#include "value/value.hpp"
+#include "visitors/visitor.hpp"
+
+// checks every annotation against the values that can reach it, and infers the type of every
+// expression from them. runs after the Resolver, so every name it looks up is defined.
+// a BinaryExpr whose operands are proven ints or floats is marked for the evaluator's fast
+// paths. that is only sound because nothing of another type can reach a typed variable:
+// the checker rejects it here, and check_inputs rejects bad @load arguments at run time
+struct TypeChecker : Visitor
+{
+    Arena *arena = nullptr;
+    std::vector<std::unordered_map<std::string, Type *>> scopes;
+    std::vector<Type *> return_types; // of the functions being checked, innermost last
+    Type *result = nullptr;           // type of the expr just visited, nullptr when unknown
+
+    void check(Program *program)
+    {
+        arena = program->arena.get();
+        scopes.push_back(std::unordered_map<std::string, Type *>());
+
+        // functions can refer to any top level name, even one declared further down
+        for (auto &input : program->inputs)
+        {
+            declare(input->identifier, input->type);
+        }
+        for (auto &stmt : program->stmts)
+        {
+            if (auto var_decl = dynamic_cast<VarDecl *>(stmt))
+            {
+                declare(var_decl->identifier, var_decl->type);
+            }
+            else if (auto fn_decl = dynamic_cast<FnDecl *>(stmt))
+            {
+                declare(fn_decl->identifier, function_type(fn_decl->params, fn_decl->return_type));
+            }
+        }
+
+        for (auto &input : program->inputs)
+        {
+            if (auto default_input = dynamic_cast<InputDefault *>(input))
+            {
+                expect(default_input->value, input->type, "default of input " + input->identifier);
+            }
+        }
+
+        for (int i = 0; i < program->stmts.size(); i++)
+        {
+            program->stmts[program->stmts.size() - 1 - i]->accept(this);
+        }
+
+        program->treeNode->accept(this);
+
+        scopes.pop_back();
+    }
+
+    static void error(const std::string &message)
+    {
+        error_output() << "Type error: " << message << std::endl;
+        error_exit();
+    }
+
+    static Type *primitive(TypeKind kind)
+    {
+        static PrimitiveType types[] = {
+            PrimitiveType(TYPE_INT), PrimitiveType(TYPE_FLOAT), PrimitiveType(TYPE_STRING),
+            PrimitiveType(TYPE_BOOL), PrimitiveType(TYPE_VOID), PrimitiveType(TYPE_NONE)};
+        return &types[kind];
+    }
+
+    static std::string name(Type *type)
+    {
+        if (type == nullptr)
+        {
+            return "any";
+        }
+
+        switch (type->kind)
+        {
+        case TYPE_INT:
+            return "int";
+        case TYPE_FLOAT:
+            return "float";
+        case TYPE_STRING:
+            return "string";
+        case TYPE_BOOL:
+            return "bool";
+        case TYPE_VOID:
+            return "void";
+        case TYPE_NONE:
+            return "none";
+        case TYPE_ARRAY:
+            return name(((ArrayType *)type)->type) + "[]";
+        default:
+        {
+            auto function = (FunctionType *)type;
+            std::string params;
+            for (int i = function->params.size() - 1; i >= 0; i--)
+            {
+                params += name(function->params[i]) + (i > 0 ? ", " : "");
+            }
+            return "(" + params + ") " + name(function->return_type);
+        }
+        }
+    }
+
+    // void is how a function says it returns none, so the two are interchangeable
+    static bool is_none(Type *type)
+    {
+        return type->kind == TYPE_VOID || type->kind == TYPE_NONE;
+    }
+
+    // unknown types match anything
+    static bool same(Type *a, Type *b)
+    {
+        if (a == nullptr || b == nullptr || a == b)
+        {
+            return true;
+        }
+        if (is_none(a) && is_none(b))
+        {
+            return true;
+        }
+        if (a->kind != b->kind)
+        {
+            return false;
+        }
+
+        if (a->kind == TYPE_ARRAY)
+        {
+            return same(((ArrayType *)a)->type, ((ArrayType *)b)->type);
+        }
+        if (a->kind == TYPE_FUNCTION)
+        {
+            auto fa = (FunctionType *)a, fb = (FunctionType *)b;
+            if (fa->params.size() != fb->params.size() || !same(fa->return_type, fb->return_type))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < fa->params.size(); i++)
+            {
+                if (!same(fa->params[i], fb->params[i]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // the run time half of the checker, used where a value comes from outside the program
+    static bool accepts(Type *type, const Value &value)
+    {
+        if (type == nullptr)
+        {
+            return true;
+        }
+
+        switch (type->kind)
+        {
+        case TYPE_INT:
+            return value.type == MyType::MYINT;
+        case TYPE_FLOAT:
+            return value.type == MyType::MYFLOAT;
+        case TYPE_STRING:
+            return value.type == MyType::MYSTRING;
+        case TYPE_BOOL:
+            return value.type == MyType::MYBOOL;
+        case TYPE_VOID:
+        case TYPE_NONE:
+            return value.type == MyType::MYNONE;
+        case TYPE_FUNCTION:
+            return value.type == MyType::MYFUNCTION;
+        default:
+            if (value.type != MyType::MYARRAY)
+            {
+                return false;
+            }
+            if (value.array->lazy)
+            {
+                return value.array->count == 0 || same(((ArrayType *)type)->type, primitive(TYPE_INT));
+            }
+            for (auto &element : value.array->elements)
+            {
+                if (!accepts(((ArrayType *)type)->type, element))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    static MyType value_type(Type *type)
+    {
+        static const MyType types[] = {MYINT, MYFLOAT, MYSTRING, MYBOOL, MYNONE, MYNONE, MYARRAY, MYFUNCTION};
+        return types[type->kind];
+    }
+
+    Type *function_type(NodeList<IdentifierType> &params, Type *return_type)
+    {
+        NodeList<Type> types;
+        types.count = params.size();
+        types.items = (Type **)arena->allocate(sizeof(Type *) * (params.size() == 0 ? 1 : params.size()), alignof(Type *));
+        for (size_t i = 0; i < params.size(); i++)
+        {
+            types.items[i] = params[i]->type;
+        }
+        return arena->make<FunctionType>(types, return_type);
+    }
+
+    void declare(const std::string &identifier, Type *type)
+    {
+        auto &scope = scopes.back();
+        auto it = scope.find(identifier);
+        if (it != scope.end() && !same(it->second, type))
+        {
+            error(identifier + " is declared as both " + name(it->second) + " and " + name(type));
+        }
+        scope[identifier] = type;
+    }
+
+    Type *lookup(const std::string &identifier)
+    {
+        for (int i = scopes.size() - 1; i >= 0; i--)
+        {
+            auto it = scopes[i].find(identifier);
+            if (it != scopes[i].end())
+            {
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    Type *type_of(Expr *expr)
+    {
+        result = nullptr;
+        expr->accept(this);
+        return result;
+    }
+
+    void expect(Expr *expr, Type *expected, const std::string &what)
+    {
+        auto type = type_of(expr);
+        if (!same(expected, type))
+        {
+            error(what + " should be " + name(expected) + ", not " + name(type));
+        }
+    }
+
+    void expect_condition(Expr *condition)
+    {
+        expect(condition, primitive(TYPE_BOOL), "condition");
+    }
+
+    Type *element_type(Expr *iterable)
+    {
+        auto type = type_of(iterable);
+        if (type == nullptr)
+        {
+            return nullptr;
+        }
+        if (type->kind == TYPE_STRING)
+        {
+            return primitive(TYPE_STRING);
+        }
+        if (type->kind != TYPE_ARRAY)
+        {
+            error("cannot iterate over " + name(type));
+        }
+        return ((ArrayType *)type)->type;
+    }
+
+    Type *array_element(const std::string &identifier)
+    {
+        auto type = lookup(identifier);
+        if (type == nullptr)
+        {
+            return nullptr;
+        }
+        if (type->kind != TYPE_ARRAY)
+        {
+            error("cannot index " + identifier + ", which is " + name(type));
+        }
+        return ((ArrayType *)type)->type;
+    }
+
+    // true when control can't reach the end of stmt
+    bool always_returns(Stmt *stmt)
+    {
+        if (dynamic_cast<ReturnStmt *>(stmt))
+        {
+            return true;
+        }
+        if (auto block = dynamic_cast<BlockStmt *>(stmt))
+        {
+            for (auto &s : block->stmts)
+            {
+                if (always_returns(s))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (auto if_else = dynamic_cast<IfElseStmt *>(stmt))
+        {
+            return always_returns(if_else->then_block) && always_returns(if_else->else_block);
+        }
+        if (auto while_stmt = dynamic_cast<WhileStmt *>(stmt))
+        {
+            // only a break gets out of a while true
+            auto condition = dynamic_cast<BoolLiteral *>(while_stmt->condition);
+            return condition != nullptr && condition->value && !breaks(while_stmt->block);
+        }
+        return false;
+    }
+
+    // true when stmt holds a break for the loop around it
+    bool breaks(Stmt *stmt)
+    {
+        if (dynamic_cast<BreakStmt *>(stmt))
+        {
+            return true;
+        }
+        if (auto block = dynamic_cast<BlockStmt *>(stmt))
+        {
+            for (auto &s : block->stmts)
+            {
+                if (breaks(s))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (auto if_stmt = dynamic_cast<IfStmt *>(stmt))
+        {
+            return breaks(if_stmt->then_block);
+        }
+        if (auto if_else = dynamic_cast<IfElseStmt *>(stmt))
+        {
+            return breaks(if_else->then_block) || breaks(if_else->else_block);
+        }
+        return false;
+    }
+
+    // mirrors the Resolver: the call frame holds the params, and the body gets a scope of its own
+    void check_function(const std::string &identifier, NodeList<IdentifierType> &params, Type *return_type, BlockStmt *block, Expr *expr)
+    {
+        return_types.push_back(return_type);
+        scopes.push_back(std::unordered_map<std::string, Type *>());
+        for (auto &param : params)
+        {
+            declare(param->identifier, param->type);
+        }
+
+        if (block != nullptr)
+        {
+            block->accept(this);
+            if (!is_none(return_type) && !always_returns(block))
+            {
+                error(identifier + " does not return a value on every path");
+            }
+        }
+        else
+        {
+            scopes.push_back(std::unordered_map<std::string, Type *>());
+            expect(expr, return_type, "result of " + identifier);
+            scopes.pop_back();
+        }
+
+        scopes.pop_back();
+        return_types.pop_back();
+    }
+
+    void check_children(NodeList<TreeNode> &children)
+    {
+        for (auto &child : children)
+        {
+            child->accept(this);
+        }
+    }
+
+    virtual void visit(IfStmt *stmt) override
+    {
+        expect_condition(stmt->condition);
+        stmt->then_block->accept(this);
+    }
+
+    virtual void visit(IfElseStmt *stmt) override
+    {
+        expect_condition(stmt->condition);
+        stmt->then_block->accept(this);
+        stmt->else_block->accept(this);
+    }
+
+    virtual void visit(WhileStmt *stmt) override
+    {
+        expect_condition(stmt->condition);
+        stmt->block->accept(this);
+    }
+
+    virtual void visit(ForInStmt *stmt) override
+    {
+        auto element = element_type(stmt->iterable);
+
+        scopes.push_back(std::unordered_map<std::string, Type *>());
+        declare(stmt->identifier, element);
+        stmt->block->accept(this);
+        scopes.pop_back();
+    }
+
+    virtual void visit(ReturnStmt *stmt) override
+    {
+        // a return at the top level just stops the program
+        if (return_types.empty())
+        {
+            if (!stmt->is_void)
+            {
+                type_of(stmt->expr);
+            }
+            return;
+        }
+
+        auto expected = return_types.back();
+        if (stmt->is_void)
+        {
+            if (!is_none(expected))
+            {
+                error("return without a value in a function returning " + name(expected));
+            }
+            return;
+        }
+        expect(stmt->expr, expected, "returned value");
+    }
+
+    virtual void visit(BreakStmt *stmt) override
+    {
+    }
+
+    virtual void visit(ContinueStmt *stmt) override
+    {
+    }
+
+    virtual void visit(FnDecl *stmt) override
+    {
+        // declared first so the function can call itself
+        declare(stmt->identifier, function_type(stmt->params, stmt->return_type));
+        check_function(stmt->identifier, stmt->params, stmt->return_type, stmt->block, nullptr);
+    }
+
+    virtual void visit(VarDecl *stmt) override
+    {
+        expect(stmt->value, stmt->type, "value of " + stmt->identifier);
+        declare(stmt->identifier, stmt->type);
+    }
+
+    virtual void visit(ExprStmt *stmt) override
+    {
+        type_of(stmt->expr);
+    }
+
+    virtual void visit(BlockStmt *stmt) override
+    {
+        scopes.push_back(std::unordered_map<std::string, Type *>());
+        for (int i = 0; i < stmt->stmts.size(); i++)
+        {
+            stmt->stmts[stmt->stmts.size() - i - 1]->accept(this);
+        }
+        scopes.pop_back();
+    }
+
+    virtual void visit(LambdaExpr *expr) override
+    {
+        check_function("lambda", expr->params, expr->return_type, nullptr, expr->expr);
+        result = function_type(expr->params, expr->return_type);
+    }
+
+    virtual void visit(AssignExpr *expr) override
+    {
+        auto type = lookup(expr->identifier);
+        expect(expr->value, type, "value assigned to " + expr->identifier);
+        result = type;
+    }
+
+    virtual void visit(ArrayAssignExpr *expr) override
+    {
+        auto element = array_element(expr->identifier);
+        expect(expr->index, primitive(TYPE_INT), "array index");
+        expect(expr->value, element, "element of " + expr->identifier);
+        result = element;
+    }
+
+    virtual void visit(TernaryExpr *expr) override
+    {
+        expect_condition(expr->condition);
+        auto then_type = type_of(expr->then_expr);
+        auto else_type = type_of(expr->else_expr);
+        if (!same(then_type, else_type))
+        {
+            error("the branches of a ternary are " + name(then_type) + " and " + name(else_type));
+        }
+        result = then_type != nullptr ? then_type : else_type;
+    }
+
+    virtual void visit(BinaryExpr *expr) override
+    {
+        auto left = type_of(expr->left);
+        auto right = type_of(expr->right);
+
+        bool logical = expr->op >= BINARY_EQ;
+        if (left == nullptr || right == nullptr)
+        {
+            result = logical ? primitive(TYPE_BOOL) : nullptr;
+            return;
+        }
+
+        // the dispatch table decides which operand types are valid, like it does at run time
+        if (!Value::binary_defined(expr->op, value_type(left), value_type(right)) || !same(left, right))
+        {
+            error(std::string("invalid operands for ") + operator_description(expr->op) + ": " + name(left) + " and " + name(right));
+        }
+
+        if (left->kind == TYPE_INT && expr->op != BINARY_AND && expr->op != BINARY_OR)
+        {
+            expr->operands = OPERANDS_INT;
+        }
+        else if (left->kind == TYPE_FLOAT)
+        {
+            expr->operands = OPERANDS_FLOAT;
+        }
+
+        result = logical ? primitive(TYPE_BOOL) : left;
+    }
+
+    virtual void visit(UnaryExpr *expr) override
+    {
+        auto type = type_of(expr->expr);
+        if (type != nullptr && !Value::unary_defined(expr->op, value_type(type)))
+        {
+            error(std::string("invalid operand for ") + operator_description(expr->op) + ": " + name(type));
+        }
+        result = expr->op == UNARY_NOT ? primitive(TYPE_BOOL) : type;
+    }
+
+    bool accepts(NativeParam param, Type *type, Type *previous)
+    {
+        if (type == nullptr)
+        {
+            return true;
+        }
+
+        switch (param)
+        {
+        case PARAM_ANY:
+            return true;
+        case PARAM_INT:
+            return type->kind == TYPE_INT;
+        case PARAM_NUMBER:
+            return type->kind == TYPE_INT || type->kind == TYPE_FLOAT;
+        case PARAM_SCALAR:
+            return type->kind == TYPE_INT || type->kind == TYPE_FLOAT || type->kind == TYPE_STRING || type->kind == TYPE_BOOL;
+        case PARAM_SEQUENCE:
+            return type->kind == TYPE_STRING || type->kind == TYPE_ARRAY;
+        case PARAM_ARRAY:
+            return type->kind == TYPE_ARRAY;
+        case PARAM_ELEMENT:
+            return previous == nullptr || same(((ArrayType *)previous)->type, type);
+        case PARAM_SAME:
+            return same(previous, type);
+        }
+        return false;
+    }
+
+    Type *check_native(const Native *native, std::vector<Type *> &args)
+    {
+        if (!native->takes(args.size()))
+        {
+            auto count = std::to_string(native->min_args);
+            if (native->max_args < 0)
+            {
+                count = "at least " + count;
+            }
+            else if (native->max_args != native->min_args)
+            {
+                count += " to " + std::to_string(native->max_args);
+            }
+            error(std::string(native->name) + " takes " + count + " arguments, not " + std::to_string(args.size()));
+        }
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (!accepts(native->param(i), args[i], i > 0 ? args[i - 1] : nullptr))
+            {
+                error(std::string("invalid argument to ") + native->name + ": " + name(args[i]));
+            }
+        }
+
+        switch (native->result)
+        {
+        case RESULT_INT:
+            return primitive(TYPE_INT);
+        case RESULT_FLOAT:
+            return primitive(TYPE_FLOAT);
+        case RESULT_STRING:
+            return primitive(TYPE_STRING);
+        case RESULT_INT_ARRAY:
+            return arena->make<ArrayType>(primitive(TYPE_INT));
+        case RESULT_FIRST:
+            return args[0];
+        default:
+            return primitive(TYPE_NONE);
+        }
+    }
+
+    virtual void visit(CallExpr *expr) override
+    {
+        std::vector<Type *> args;
+        for (auto &arg : expr->args)
+        {
+            args.push_back(type_of(arg));
+        }
+
+        auto callee = lookup(expr->identifier);
+        auto native = callee == nullptr ? StandardLib::native(expr->identifier) : nullptr;
+        if (native != nullptr)
+        {
+            // args are stored last to first
+            std::reverse(args.begin(), args.end());
+            result = check_native(native, args);
+            return;
+        }
+
+        if (callee == nullptr)
+        {
+            return;
+        }
+        if (callee->kind != TYPE_FUNCTION)
+        {
+            error("cannot call " + expr->identifier + ", which is " + name(callee));
+        }
+
+        auto function = (FunctionType *)callee;
+        if (args.size() != function->params.size())
+        {
+            error(expr->identifier + " takes " + std::to_string(function->params.size()) + " arguments, not " + std::to_string(args.size()));
+        }
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (!same(function->params[i], args[i]))
+            {
+                error("argument to " + expr->identifier + " should be " + name(function->params[i]) + ", not " + name(args[i]));
+            }
+        }
+        result = function->return_type;
+    }
+
+    virtual void visit(ArrayAccessExpr *expr) override
+    {
+        auto element = array_element(expr->identifier);
+        expect(expr->index, primitive(TYPE_INT), "array index");
+        result = element;
+    }
+
+    virtual void visit(IntLiteral *expr) override
+    {
+        result = primitive(TYPE_INT);
+    }
+
+    virtual void visit(FloatLiteral *expr) override
+    {
+        result = primitive(TYPE_FLOAT);
+    }
+
+    virtual void visit(StringLiteral *expr) override
+    {
+        result = primitive(TYPE_STRING);
+    }
+
+    virtual void visit(NoneLiteral *expr) override
+    {
+        result = primitive(TYPE_NONE);
+    }
+
+    virtual void visit(BoolLiteral *expr) override
+    {
+        result = primitive(TYPE_BOOL);
+    }
+
+    virtual void visit(IdentifierExpr *expr) override
+    {
+        result = lookup(expr->identifier);
+    }
+
+    virtual void visit(ArrayLiteral *expr) override
+    {
+        Type *element = nullptr;
+        for (int i = expr->elements.size() - 1; i >= 0; i--)
+        {
+            auto type = type_of(expr->elements[i]);
+            if (!same(element, type))
+            {
+                error("array elements should all be " + name(element) + ", not " + name(type));
+            }
+            if (element == nullptr)
+            {
+                element = type;
+            }
+        }
+        result = arena->make<ArrayType>(element);
+    }
+
+    virtual void visit(AndNode *node) override
+    {
+        check_children(node->children);
+    }
+
+    virtual void visit(OrNode *node) override
+    {
+        check_children(node->children);
+    }
+
+    virtual void visit(ThenNode *node) override
+    {
+        check_children(node->children);
+    }
+
+    virtual void visit(BehaviorNode *node) override
+    {
+        for (auto &arg : node->args)
+        {
+            type_of(arg);
+        }
+    }
+
+    virtual void visit(AtLoadNode *at_load) override
+    {
+        // args are stored last to first, so the path is at the end
+        for (int i = 0; i < at_load->args.size(); i++)
+        {
+            if (i == at_load->args.size() - 1)
+            {
+                expect(at_load->args[i], primitive(TYPE_STRING), "path passed to @load");
+            }
+            else
+            {
+                type_of(at_load->args[i]);
+            }
+        }
+    }
+
+    virtual void visit(AtIfNode *at_if) override
+    {
+        expect_condition(at_if->condition);
+        check_children(at_if->children);
+    }
+
+    virtual void visit(AtIfElseNode *at_if_else) override
+    {
+        expect_condition(at_if_else->condition);
+        check_children(at_if_else->then_children);
+        check_children(at_if_else->else_children);
+    }
+
+    virtual void visit(AtForNode *at_for) override
+    {
+        auto element = element_type(at_for->iterable);
+
+        scopes.push_back(std::unordered_map<std::string, Type *>());
+        declare(at_for->identifier, element);
+        check_children(at_for->children);
+        scopes.pop_back();
+    }
+
+    virtual void visit(InputDefault *input) override
+    {
+    }
+
+    virtual void visit(Input *input) override
+    {
+    }
+};
+
+// an input falls back to its default when it isn't passed, or when it is passed none and none
+// isn't of its type. so a json object can bind a later input by name alone, and the ones it
+// leaves out before it are none
+inline bool uses_default(Input *input, const std::vector<Value> &args, size_t i)
+{
+    if (i >= args.size())
+    {
+        return true;
+    }
+    return args[i].type == MyType::MYNONE && dynamic_cast<InputDefault *>(input) != nullptr && !TypeChecker::accepts(input->type, args[i]);
+}
+
+// @load arguments are only known at run time, so they are checked when the program starts.
+// an input without a default has to be passed in, or it would hold none instead of its type
+inline void check_inputs(Program *program, const std::vector<Value> &args)
+{
+    for (size_t i = 0; i < program->inputs.size(); i++)
+    {
+        auto input = program->inputs[i];
+        if (uses_default(input, args, i))
+        {
+            if (dynamic_cast<InputDefault *>(input) == nullptr)
+            {
+                error_output() << "Input " << input->identifier << " has no default and was not passed a value" << std::endl;
+                error_exit();
+            }
+        }
+        else if (!TypeChecker::accepts(input->type, args[i]))
+        {
+            error_output() << "Input " << input->identifier << " should be " << TypeChecker::name(input->type) << std::endl;
+            error_exit();
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "value/value.hpp"
+
+enum OpCode : uint8_t
+{
+    OP_LOADK,      // R[a] = K[bx]
+    OP_LOADI,      // R[a] = (int)bx
+    OP_LOADNONE,   // R[a] = None
+    OP_LOADBOOL,   // R[a] = (bool)b
+    OP_MOVE,       // R[a] = R[b]
+    OP_GETGLOBAL,  // R[a] = G[bx]
+    OP_SETGLOBAL,  // G[bx] = R[a], G[bx] must already be defined
+    OP_DEFGLOBAL,  // G[bx] = R[a]
+    OP_GETCAPTURE, // R[a] = C[b]
+    OP_SETCAPTURE, // C[b] = R[a]
+    OP_CLOSECAPTURES, // close the captured variables in R[a] and above
+    OP_ADD,        // R[a] = R[b] op R[c], in the same order as BinaryOperator
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_POW,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_ADDI,       // OP_ADD to OP_GE again, for operands the TypeChecker proved are ints
+    OP_SUBI,
+    OP_MULI,
+    OP_DIVI,
+    OP_MODI,
+    OP_POWI,
+    OP_EQI,
+    OP_NEI,
+    OP_LTI,
+    OP_LEI,
+    OP_GTI,
+    OP_GEI,
+    OP_ADDF,       // and for operands it proved are floats
+    OP_SUBF,
+    OP_MULF,
+    OP_DIVF,
+    OP_MODF,
+    OP_POWF,
+    OP_EQF,
+    OP_NEF,
+    OP_LTF,
+    OP_LEF,
+    OP_GTF,
+    OP_GEF,
+    OP_NEG,        // R[a] = op R[b], in the same order as UnaryOperator
+    OP_NOT,
+    OP_JMP,        // pc = bx
+    OP_JMPF,       // if not R[a] then pc = bx
+    OP_JMPT,       // if R[a] then pc = bx
+    OP_JMPDEF,     // if G[a] is defined then pc = bx
+    OP_NEWARRAY,   // R[a] = [R[b], ..., R[b + c - 1]]
+    OP_GETINDEX,   // R[a] = R[b][R[c]]
+    OP_SETINDEX,   // R[a][R[b]] = R[c]
+    OP_CLOSURE,    // R[a] = closure(P[bx])
+    OP_CALL,       // R[a] = R[b](R[a], ..., R[a + c - 1])
+    OP_CALLG,      // R[a] = G[b](R[a], ..., R[a + c - 1]), falling back to a builtin
+    OP_TAILCALL,   // return R[b](R[a], ..., R[a + c - 1]), reusing the current frame
+    OP_TAILCALLG,  // return G[b](R[a], ..., R[a + c - 1]), reusing the current frame
+    OP_CALLN,      // R[a] = builtin b(R[a], ..., R[a + c - 1])
+    OP_RETURN,     // return R[a]
+    OP_RETURNNONE, // return None
+    OP_FORPREP,    // check R[a] is iterable, R[a + 1] = 0
+    OP_FORNEXT,    // R[a + 2] = R[a][R[a + 1]++] or pc = bx when exhausted
+    OP_OPEN,       // push a new tree node of kind a
+    OP_CLOSE,      // pop the current tree node and add it to its parent
+    OP_BEHAVIOR,   // add a behavior named K[a] with args R[b], ..., R[b + c - 1]
+    OP_LOAD,       // @load(R[b], ..., R[b + c - 1]), queued with the loads after it when a is set
+    OP_HALT,
+};
+
+static_assert(OP_GE - OP_ADD == BINARY_GE, "binary opcodes must follow BinaryOperator");
+static_assert(OP_GEI - OP_ADDI == BINARY_GE, "int opcodes must follow BinaryOperator");
+static_assert(OP_GEF - OP_ADDF == BINARY_GE, "float opcodes must follow BinaryOperator");
+static_assert(OP_NOT - OP_NEG == UNARY_NOT, "unary opcodes must follow UnaryOperator");
+
+enum TreeKind : uint8_t
+{
+    TREE_AND,
+    TREE_OR,
+    TREE_THEN,
+    TREE_PSEUDO,
+};
+
+// 8 bytes per instruction: jump targets and wide constant indices are packed into b and c
+struct Instruction
+{
+    OpCode op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+
+    Instruction(OpCode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) : op(op), a(a), b(b), c(c) {}
+
+    uint32_t bx() const
+    {
+        return ((uint32_t)b << 16) | c;
+    }
+
+    void set_bx(uint32_t value)
+    {
+        b = (uint16_t)(value >> 16);
+        c = (uint16_t)(value & 0xffff);
+    }
+};
+
+// where a closure finds each variable it captures when it is created: a register of the
+// enclosing frame, or one of the enclosing closure's own captures
+struct CaptureInfo
+{
+    bool from_register;
+    uint16_t index;
+};
+
+// a captured variable, shared by every closure that captures it. it stays open, reading and
+// writing the register the variable lives in, until the register goes out of scope. it is then
+// closed over the value, so the enclosing frame and every closure see each other's writes
+struct Upvalue : HeapObject<Upvalue>
+{
+    std::vector<Value> *registers; // of the VM the variable lives in. nullptr once closed
+    size_t slot;
+    Value closed;
+
+    Upvalue(std::vector<Value> *registers, size_t slot) : registers(registers), slot(slot)
+    {
+        set_bytes(sizeof(Upvalue));
+    }
+
+    Value &value()
+    {
+        return registers != nullptr ? (*registers)[slot] : closed;
+    }
+
+    void close()
+    {
+        closed = (*registers)[slot];
+        registers = nullptr;
+    }
+};
+
+struct FunctionProto
+{
+    std::string name;
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<CaptureInfo> captures;
+    uint16_t num_params = 0;
+    uint16_t num_registers = 0;
+};
+
+struct CompiledProgram
+{
+    // protos[0] is the top level of the program
+    std::vector<std::unique_ptr<FunctionProto>> protos;
+    std::vector<std::string> globals;
+    std::vector<uint16_t> input_slots;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "dhtt.hpp"
+#include "loader.hpp"
+#include "stack.hpp"
+#include "standard_lib.hpp"
+#include "value/value.hpp"
+#include "vm/chunk.hpp"
+
+// executes the bytecode produced by the Compiler
+struct VM
+{
+    struct Frame
+    {
+        FunctionProto *proto;
+        Callable *closure;
+        const Instruction *pc;
+        size_t base;
+    };
+
+    DHTT::Tree tree;
+
+    std::shared_ptr<CompiledProgram> program; // the Program's, compiled once
+    std::vector<Value> registers;
+    std::vector<Value> globals;
+    std::vector<bool> defined;
+    std::vector<const Native *> natives; // the builtin a global names, called while it is undefined
+    std::vector<Frame> frames;
+    std::vector<Upvalue *> open_captures; // by slot, each holding a reference
+
+    // a run of sibling loads being queued for run_loads, and what was printed since the last one
+    std::vector<LoadJob> queued_loads;
+    std::ostringstream between_loads;
+    std::ostream *saved_output = nullptr;
+
+    void evaluate(Program *program);
+    void evaluate(Program *program, std::vector<Value> inputs);
+
+    void run();
+    Upvalue *capture(size_t slot);
+    void close_captures(size_t level);
+    void error(std::string message);
+    void load(std::vector<Value> args, bool more_follow);
+};
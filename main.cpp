@@ -3,75 +3,219 @@
  */
 
 #include <iostream>
-#include <fstream>
-#include <algorithm>
+#include <chrono>
 #include "ast_nodes/ast.hpp"
 #include "parser.hpp"
 #include "visitors/visitor.hpp"
 #include "visitors/printer.hpp"
 #include "visitors/interpreter.hpp"
+#include "vm/vm.hpp"
+#include "loader.hpp"
+#include "source_buffer.hpp"
 #include "dhtt.hpp"
+#include "tree_sink.hpp"
+#include "output_buffer.hpp"
+#include "server.hpp"
+#include "batch.hpp"
+#include "native_stack.hpp"
+#include "value/callable.hpp"
+#include <unistd.h>
 
-void ros_parse(Program **root, const char *source);
-
-void print_tree(DHTT::Node *root, int indent = 0)
+int main(int argc, char *argv[])
 {
-    if (root == nullptr)
+    bool interpret = false;
+    bool gc_stats = false;
+    bool load_stats = false;
+    bool parse_only = false;
+    bool dump_ast = true;
+    bool stream = false;
+    std::string emit = "text";
+    const char *filename = nullptr;
+    const char *output_path = nullptr;
+    const char *serve_path = nullptr;
+    const char *batch_path = nullptr;
+    int jobs = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--interpret")
+        {
+            interpret = true;
+        }
+        else if (arg == "--gc-stats")
+        {
+            gc_stats = true;
+        }
+        else if (arg == "--load-stats")
+        {
+            load_stats = true;
+        }
+        else if (arg == "--memoize-loads")
+        {
+            memoize_all_loads();
+        }
+        else if (arg == "--memoize-load" && i + 1 < argc)
+        {
+            memoize_loads_of(argv[++i]);
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            jobs = atoi(argv[++i]);
+            set_load_jobs(jobs);
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            set_max_call_depth(atoi(argv[++i]));
+        }
+        else if (arg == "--emit=text" || arg == "--emit=json" || arg == "--emit=yaml" || arg == "--emit=bin")
+        {
+            emit = arg.substr(7);
+        }
+        else if (arg == "--stream")
+        {
+            stream = true;
+        }
+        else if (arg == "-o" && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else if (arg == "--no-ast")
+        {
+            dump_ast = false;
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            serve_path = argv[++i];
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_path = argv[++i];
+        }
+        else if (arg == "--parse-only")
+        {
+            parse_only = true;
+        }
+        else if (arg == "-O0" || arg == "-O1")
+        {
+            set_optimization_level(arg[2] - '0');
+        }
+        else
+        {
+            filename = argv[i];
+        }
+    }
+
+    if (serve_path != nullptr)
     {
-        return;
+        return serve(serve_path, interpret);
     }
 
-    for (int i = 0; i < indent; i++)
+    if (filename == nullptr)
     {
-        std::cout << "  ";
+        std::cerr << "Usage: " << argv[0] << " [--interpret] [--gc-stats] [--load-stats] [--memoize-loads] [--memoize-load <file>] [--jobs N] [--max-depth N] [--emit=text|json|yaml|bin] [--stream] [--no-ast] [-o <file>] [--parse-only] [-O0|-O1] <filename>" << std::endl;
+        std::cerr << "       " << argv[0] << " [--interpret] [--jobs N] [--max-depth N] [-O0|-O1] --serve <socket>|-" << std::endl;
+        std::cerr << "       " << argv[0] << " [--interpret] [--jobs N] [--max-depth N] [--emit=text|json|yaml] [-o <file>] [-O0|-O1] --batch <inputs.jsonl> <filename>" << std::endl;
+        std::cerr << "--max-depth N stops a program once calls nest N deep, " << DEFAULT_MAX_CALL_DEPTH << " by default. --interpret also stops" << std::endl;
+        std::cerr << "when its " << (DEEP_STACK_BYTES >> 20) << "MB native stack fills up, whatever N is" << std::endl;
+        return 1;
     }
 
-    root->sayName();
+    // the binary tree would be mixed up with everything else printed on stdout
+    if (emit == "bin" && output_path == nullptr)
+    {
+        std::cerr << "--emit=bin needs -o <file>" << std::endl;
+        return 1;
+    }
 
-    for (auto &child : root->children)
+    if (parse_only)
     {
-        print_tree(child.get(), indent + 1);
+        // parse throughput: load and free the program without running it
+        SourceBuffer source;
+        size_t lines = source.load(filename) ? source.lines() : 0;
+
+        auto start = std::chrono::steady_clock::now();
+        Program *root = load_program(filename, true);
+        auto parsed = std::chrono::steady_clock::now();
+        delete root;
+        auto freed = std::chrono::steady_clock::now();
+
+        double parse_seconds = std::chrono::duration<double>(parsed - start).count();
+        double free_seconds = std::chrono::duration<double>(freed - parsed).count();
+        std::cerr << "parsed " << lines << " lines in " << parse_seconds * 1000 << " ms ("
+                  << (long)(lines / parse_seconds) << " lines/sec), freed in " << free_seconds * 1000 << " ms" << std::endl;
+        return 0;
     }
-}
 
-int main(int argc, char *argv[])
-{
+    // everything for stdout goes through one large buffer, written when it fills up and at exit.
+    // std::cerr flushes it first, so errors still come after what was printed before them
+    static Output standard_output(STDOUT_FILENO);
+    StandardLib::output() = &standard_output;
+    std::cerr.tie(&standard_output);
 
-    if (argc < 2)
+    static std::unique_ptr<Output> file;
+    if (output_path != nullptr)
     {
-        std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
-        return 1;
+        file.reset(Output::create(output_path));
+        if (file == nullptr)
+        {
+            std::cerr << "Could not open output file: " << output_path << std::endl;
+            return 1;
+        }
     }
+    std::ostream &out = file != nullptr ? *file : standard_output;
 
-    std::ifstream file(argv[1]);
-    if (!file.is_open())
+    if (batch_path != nullptr)
     {
-        std::cerr << "Could not open file: " << argv[1] << std::endl;
-        return 1;
+        return run_batch(batch_path, filename, emit, interpret, jobs, out);
     }
 
-    std::string source;
-    std::string line;
-    while (getline(file, line))
+    Program *root = load_program(filename, true);
+
+    if (dump_ast)
     {
-        source += line + '\n';
+        Printer printer(standard_output);
+        printer.print(root);
     }
 
-    file.close();
+    std::unique_ptr<DHTT::Sink> sink(DHTT::make_sink(emit, out));
 
-    Program *root = nullptr;
-    ros_parse(&root, source.c_str());
+    // streaming, the tree hands each finished subtree of the root to the sink and lets it go,
+    // so it never holds more than one of them. anything the program prints lands in between,
+    // which only text can take: json or yaml on stdout gets the prints sent to stderr instead
+    if (stream && emit != "text" && output_path == nullptr)
+    {
+        StandardLib::output() = &std::cerr;
+    }
 
-    Printer printer;
+    DHTT::Tree tree;
+    if (interpret)
+    {
+        // the tree-walking interpreter is kept as a reference for the VM
+        Interpreter interpreter;
+        interpreter.tree.sink = stream ? sink.get() : nullptr;
+        interpreter.evaluate(root);
+        tree = std::move(interpreter.tree);
+    }
+    else
+    {
+        VM vm;
+        vm.tree.sink = stream ? sink.get() : nullptr;
+        vm.evaluate(root);
+        tree = std::move(vm.tree);
+    }
 
-    printer.print(root);
+    // with --stream the roots are gone already, and this only finishes the output
+    DHTT::emit(tree, *sink);
 
-    Interpreter interpreter;
-    interpreter.evaluate(root);
+    if (gc_stats)
+    {
+        heap_stats().report(std::cerr);
+    }
 
-    for (auto &root : interpreter.roots)
+    if (load_stats)
     {
-        print_tree(root.get());
+        load_cache_stats().report(std::cerr);
     }
 
     return 0;
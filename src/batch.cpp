@@ -0,0 +1,149 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "error_exit.hpp"
+#include "json.hpp"
+#include "loader.hpp"
+#include "native_stack.hpp"
+#include "standard_lib.hpp"
+#include "tree_sink.hpp"
+#include "visitors/interpreter.hpp"
+#include "vm/vm.hpp"
+
+int run_batch(const char *inputs_path, const char *program_path, const std::string &emit, bool interpret, int workers, std::ostream &out)
+{
+    if (emit == "bin")
+    {
+        std::cerr << "--batch can't --emit=bin, since the trees would run together" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(inputs_path);
+    if (!file)
+    {
+        std::cerr << "Could not open file: " << inputs_path << std::endl;
+        return 1;
+    }
+
+    // blank lines bind nothing, so they are skipped rather than run with every default
+    std::vector<std::string> lines;
+    std::vector<size_t> line_numbers;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); number++)
+    {
+        if (line.find_first_not_of(" \t\r") != std::string::npos)
+        {
+            lines.push_back(line);
+            line_numbers.push_back(number);
+        }
+    }
+
+    // not the main program, so the defaults of its inputs aren't folded into it
+    auto program = load_cached_program(program_path);
+
+    // each line's output, until it has been written, and the error that stopped it
+    std::vector<std::string> outputs(lines.size());
+    std::vector<std::string> errors(lines.size());
+    std::vector<char> ready(lines.size(), 0);
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{lines.size()}; // the first line known to have failed
+
+    auto work = [&]()
+    {
+        // one VM per thread, which compiles the program for its first line and reuses it after
+        VM vm;
+        for (size_t i; (i = next++) < lines.size() && i < failed;)
+        {
+            std::ostringstream output;
+            StandardLib::output() = &output;
+            auto error = catch_errors([&]()
+                                      {
+            if (emit == "yaml")
+            {
+                output << "---\n";
+            }
+
+            auto what = "line " + std::to_string(line_numbers[i]) + " of " + inputs_path;
+            auto inputs = json_inputs(program.get(), parse_json(lines[i], what.c_str()));
+
+            DHTT::Tree tree;
+            if (interpret)
+            {
+                Interpreter interpreter;
+                interpreter.evaluate(program.get(), inputs);
+                tree = std::move(interpreter.tree);
+            }
+            else
+            {
+                vm.tree = DHTT::Tree();
+                vm.evaluate(program.get(), inputs);
+                tree = std::move(vm.tree);
+            }
+
+            std::unique_ptr<DHTT::Sink> sink(DHTT::make_sink(emit, output));
+            DHTT::emit(tree, *sink); });
+
+            std::lock_guard<std::mutex> lock(mutex);
+            outputs[i] = output.str();
+            errors[i] = error;
+            ready[i] = 1;
+            changed.notify_all();
+            if (!error.empty())
+            {
+                // the lines after it are never written, and the VM stopped partway through it.
+                // the lines before it are all taken already, by this thread or another
+                failed = std::min<size_t>(failed, i);
+                return;
+            }
+        }
+    };
+
+    if (workers <= 0)
+    {
+        workers = std::thread::hardware_concurrency();
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < std::max(workers, 1); i++)
+    {
+        threads.push_back(std::thread([&]()
+                                      { on_deep_stack(work); }));
+    }
+
+    // written as soon as every line before it is, so outputs only holds the lines still waiting.
+    // a line that failed is written up to its error, which ends the batch as it would a run
+    std::string error;
+    for (size_t i = 0; i < lines.size() && error.empty(); i++)
+    {
+        std::string text;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]()
+                         { return ready[i] != 0; });
+            text.swap(outputs[i]);
+            error.swap(errors[i]);
+        }
+        out << text;
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (!error.empty())
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "dhtt.hpp"
+#include "tree_sink.hpp"
+
+using namespace DHTT;
+
+NodeId Tree::make(Kind kind, size_t mark)
+{
+    kinds.push_back(kind);
+    child_ids.insert(child_ids.end(), pending.begin() + mark, pending.end());
+    pending.resize(mark);
+    first_child.push_back(child_ids.size());
+    first_string.push_back(string_start.size() - 1);
+    return kinds.size() - 1;
+}
+
+void Tree::open(Kind kind)
+{
+    if (open_nodes.empty())
+    {
+        if (sink != nullptr)
+        {
+            sink->open_root(kind);
+        }
+    }
+    else if (kind != PSEUDO)
+    {
+        nested++;
+    }
+    open_nodes.push_back(Open{kind, pending.size()});
+}
+
+void Tree::close()
+{
+    auto node = open_nodes.back();
+    open_nodes.pop_back();
+    if (!open_nodes.empty() && node.kind != PSEUDO)
+    {
+        nested--;
+    }
+
+    if (node.kind == PSEUDO && !open_nodes.empty())
+    {
+        return;
+    }
+
+    // the root's children have all been streamed already
+    if (open_nodes.empty() && sink != nullptr)
+    {
+        sink->close_root();
+        return;
+    }
+
+    add(make(node.kind, node.mark));
+}
+
+void Tree::add(NodeId node)
+{
+    if (sink != nullptr && nested == 0)
+    {
+        sink->node(*this, node);
+        clear();
+    }
+    else if (open_nodes.empty())
+    {
+        roots.push_back(node);
+    }
+    else
+    {
+        pending.push_back(node);
+    }
+}
+
+void Tree::clear()
+{
+    kinds.clear();
+    first_child.resize(1);
+    first_string.resize(1);
+    child_ids.clear();
+    string_start.resize(1);
+    text.clear();
+}
+
+void Tree::splice(const Tree &other)
+{
+    // streaming, there is nothing to splice into: the other tree goes to the sink as it is
+    if (sink != nullptr && nested == 0)
+    {
+        for (auto root : other.roots)
+        {
+            if (other.kinds[root] == PSEUDO && !open_nodes.empty())
+            {
+                for (auto child = other.children_begin(root); child != other.children_end(root); child++)
+                {
+                    sink->node(other, *child);
+                }
+            }
+            else
+            {
+                sink->node(other, root);
+            }
+        }
+        return;
+    }
+
+    // every array is appended whole, with its indices moved past what this tree already holds
+    NodeId node_base = kinds.size();
+    uint32_t child_base = child_ids.size();
+    uint32_t string_base = string_start.size() - 1;
+    uint32_t text_base = text.size();
+
+    kinds.insert(kinds.end(), other.kinds.begin(), other.kinds.end());
+    for (size_t i = 1; i < other.first_child.size(); i++)
+    {
+        first_child.push_back(other.first_child[i] + child_base);
+        first_string.push_back(other.first_string[i] + string_base);
+    }
+    for (auto child : other.child_ids)
+    {
+        child_ids.push_back(child + node_base);
+    }
+    for (size_t i = 1; i < other.string_start.size(); i++)
+    {
+        string_start.push_back(other.string_start[i] + text_base);
+    }
+    text += other.text;
+
+    for (auto root : other.roots)
+    {
+        root += node_base;
+        if (kinds[root] == PSEUDO && !open_nodes.empty())
+        {
+            pending.insert(pending.end(), children_begin(root), children_end(root));
+        }
+        else
+        {
+            add(root);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#include "error_exit.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+// initialized before main, so on the main thread
+static const std::thread::id main_thread = std::this_thread::get_id();
+
+static thread_local int exits = -1; // -1 until it is set, when only the main thread can
+static thread_local std::ostringstream *caught = nullptr;
+
+// thrown by error_exit inside catch_errors
+struct CaughtError
+{
+};
+
+ErrorHandling error_handling()
+{
+    return ErrorHandling{exits >= 0 ? exits != 0 : std::this_thread::get_id() == main_thread, caught};
+}
+
+void set_error_handling(const ErrorHandling &handling)
+{
+    exits = handling.exits ? 1 : 0;
+    caught = handling.caught;
+}
+
+std::ostream &error_output()
+{
+    return caught != nullptr ? (std::ostream &)*caught : std::cerr;
+}
+
+std::string catch_errors(const std::function<void()> &body)
+{
+    std::ostringstream message;
+    auto saved = caught;
+    caught = &message;
+
+    std::string error;
+    try
+    {
+        body();
+    }
+    catch (const CaughtError &)
+    {
+        error = message.str();
+        if (!error.empty() && error.back() == '\n')
+        {
+            error.pop_back();
+        }
+    }
+    catch (...)
+    {
+        caught = saved;
+        throw;
+    }
+    caught = saved;
+    return error;
+}
+
+void error_exit()
+{
+    if (caught != nullptr)
+    {
+        throw CaughtError();
+    }
+
+    if (error_handling().exits)
+    {
+        exit(1);
+    }
+
+    // what was printed to stdout before the error went out with it, through std::cerr's tie
+    std::cerr.flush();
+    _exit(1);
+}
@@ -0,0 +1,341 @@
+#include "json.hpp"
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "ast_nodes/ast.hpp"
+#include "error_exit.hpp"
+#include "value/array.hpp"
+
+const Json *Json::get(const std::string &key) const
+{
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == key)
+        {
+            return &items[i];
+        }
+    }
+    return nullptr;
+}
+
+// recursive descent over the text, exiting at the first thing that isn't json
+struct JsonParser
+{
+    const char *at;
+    const char *end;
+    const char *what;
+
+    void fail(const char *expected)
+    {
+        error_output() << "Could not parse " << what << ": expected " << expected << std::endl;
+        error_exit();
+    }
+
+    void skip_space()
+    {
+        while (at < end && (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r'))
+        {
+            at++;
+        }
+    }
+
+    bool take(char c)
+    {
+        skip_space();
+        if (at < end && *at == c)
+        {
+            at++;
+            return true;
+        }
+        return false;
+    }
+
+    bool take_word(const char *word)
+    {
+        size_t length = strlen(word);
+        if ((size_t)(end - at) >= length && strncmp(at, word, length) == 0)
+        {
+            at += length;
+            return true;
+        }
+        return false;
+    }
+
+    static void append_utf8(std::string &out, unsigned code)
+    {
+        if (code < 0x80)
+        {
+            out += (char)code;
+        }
+        else if (code < 0x800)
+        {
+            out += (char)(0xc0 | code >> 6);
+            out += (char)(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            out += (char)(0xe0 | code >> 12);
+            out += (char)(0x80 | (code >> 6 & 0x3f));
+            out += (char)(0x80 | (code & 0x3f));
+        }
+    }
+
+    std::string string()
+    {
+        if (!take('"'))
+        {
+            fail("a string");
+        }
+
+        std::string out;
+        while (at < end && *at != '"')
+        {
+            if (*at != '\\')
+            {
+                out += *at++;
+                continue;
+            }
+
+            if (++at == end)
+            {
+                break;
+            }
+            switch (*at++)
+            {
+            case 'n':
+                out += '\n';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'u':
+            {
+                // surrogate pairs are kept as two code points
+                if (end - at < 4)
+                {
+                    fail("four hex digits after \\u");
+                }
+                append_utf8(out, strtoul(std::string(at, 4).c_str(), nullptr, 16));
+                at += 4;
+                break;
+            }
+            default:
+                out += at[-1];
+                break;
+            }
+        }
+
+        if (at == end)
+        {
+            fail("a closing quote");
+        }
+        at++;
+        return out;
+    }
+
+    Json number()
+    {
+        Json json;
+        const char *start = at;
+        bool integral = true;
+        if (at < end && *at == '-')
+        {
+            at++;
+        }
+        while (at < end && (isdigit(*at) || *at == '.' || *at == 'e' || *at == 'E' || *at == '+' || *at == '-'))
+        {
+            integral = integral && isdigit(*at);
+            at++;
+        }
+
+        std::string text(start, at);
+        if (text.empty() || text == "-")
+        {
+            fail("a value");
+        }
+        if (integral)
+        {
+            json.kind = Json::JSON_INT;
+            json.integer = strtoll(text.c_str(), nullptr, 10);
+        }
+        else
+        {
+            json.kind = Json::JSON_FLOAT;
+            json.number = strtod(text.c_str(), nullptr);
+        }
+        return json;
+    }
+
+    Json value()
+    {
+        Json json;
+        skip_space();
+        if (at < end && *at == '"')
+        {
+            json.kind = Json::JSON_STRING;
+            json.string = string();
+        }
+        else if (take('['))
+        {
+            json.kind = Json::JSON_ARRAY;
+            if (!take(']'))
+            {
+                do
+                {
+                    json.items.push_back(value());
+                } while (take(','));
+                if (!take(']'))
+                {
+                    fail("',' or ']'");
+                }
+            }
+        }
+        else if (take('{'))
+        {
+            json.kind = Json::JSON_OBJECT;
+            if (!take('}'))
+            {
+                do
+                {
+                    json.keys.push_back(string());
+                    if (!take(':'))
+                    {
+                        fail("':'");
+                    }
+                    json.items.push_back(value());
+                } while (take(','));
+                if (!take('}'))
+                {
+                    fail("',' or '}'");
+                }
+            }
+        }
+        else if (take_word("true"))
+        {
+            json.kind = Json::JSON_BOOL;
+            json.boolean = true;
+        }
+        else if (take_word("false"))
+        {
+            json.kind = Json::JSON_BOOL;
+        }
+        else if (take_word("null"))
+        {
+            json.kind = Json::JSON_NULL;
+        }
+        else
+        {
+            json = number();
+        }
+        return json;
+    }
+};
+
+Json parse_json(const std::string &text, const char *what)
+{
+    JsonParser parser{text.data(), text.data() + text.size(), what};
+    auto json = parser.value();
+    parser.skip_space();
+    if (parser.at != parser.end)
+    {
+        parser.fail("the end of the value");
+    }
+    return json;
+}
+
+static Value to_value(const Json &json, const std::string &input)
+{
+    switch (json.kind)
+    {
+    case Json::JSON_BOOL:
+        return Value(json.boolean);
+    case Json::JSON_INT:
+        if (json.integer < INT_MIN || json.integer > INT_MAX)
+        {
+            error_output() << "Input " << input << " is out of range for an int" << std::endl;
+            error_exit();
+        }
+        return Value((int)json.integer);
+    case Json::JSON_FLOAT:
+        return Value((float)json.number);
+    case Json::JSON_STRING:
+        return Value(json.string);
+    case Json::JSON_ARRAY:
+    {
+        std::vector<Value> elements;
+        for (auto &item : json.items)
+        {
+            elements.push_back(to_value(item, input));
+        }
+        return Value(new Array(elements));
+    }
+    case Json::JSON_OBJECT:
+        error_output() << "Input " << input << " can't be an object" << std::endl;
+        error_exit();
+    default:
+        return Value();
+    }
+}
+
+std::vector<Value> json_inputs(Program *program, const Json &inputs)
+{
+    std::vector<Value> values;
+    if (inputs.kind == Json::JSON_ARRAY)
+    {
+        for (size_t i = 0; i < inputs.items.size(); i++)
+        {
+            auto name = i < program->inputs.size() ? program->inputs[i]->identifier : std::to_string(i);
+            values.push_back(to_value(inputs.items[i], name));
+        }
+        return values;
+    }
+
+    if (inputs.kind != Json::JSON_OBJECT)
+    {
+        error_output() << "Inputs should be an array or an object" << std::endl;
+        error_exit();
+    }
+
+    for (auto &key : inputs.keys)
+    {
+        bool found = false;
+        for (auto input : program->inputs)
+        {
+            found = found || input->identifier == key;
+        }
+        if (!found)
+        {
+            error_output() << "Input " << key << " not defined" << std::endl;
+            error_exit();
+        }
+    }
+
+    // in declaration order, up to the last one that is bound. the ones left out before it are
+    // none, which leaves them to their defaults
+    size_t count = 0;
+    for (size_t i = 0; i < program->inputs.size(); i++)
+    {
+        if (inputs.get(program->inputs[i]->identifier) != nullptr)
+        {
+            count = i + 1;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        auto &name = program->inputs[i]->identifier;
+        auto value = inputs.get(name);
+        values.push_back(value != nullptr ? to_value(*value, name) : Value());
+    }
+    return values;
+}
@@ -0,0 +1,477 @@
+#include <iostream>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "loader.hpp"
+#include "error_exit.hpp"
+#include "native_stack.hpp"
+#include "source_buffer.hpp"
+#include "ast_nodes/ast.hpp"
+#include "visitors/optimizer.hpp"
+#include "visitors/resolver.hpp"
+#include "visitors/type_checker.hpp"
+#include "standard_lib.hpp"
+
+void ros_parse(Program **root, SourceBuffer &source);
+
+static int optimization_level = 1;
+
+void set_optimization_level(int level)
+{
+    optimization_level = level;
+}
+
+static Program *parse_program(SourceBuffer &source, const std::string &path, bool main_program)
+{
+    Program *root = nullptr;
+    ros_parse(&root, source);
+
+    if (root == nullptr)
+    {
+        error_output() << "Could not parse file: " << path << std::endl;
+        error_exit();
+    }
+
+    TypeChecker type_checker;
+    type_checker.check(root);
+
+    if (optimization_level > 0)
+    {
+        Optimizer optimizer;
+        optimizer.optimize(root, main_program);
+    }
+
+    Resolver resolver;
+    resolver.resolve(root);
+
+    return root;
+}
+
+Program *load_program(std::string path, bool main_program)
+{
+    SourceBuffer source;
+    if (!source.load(path))
+    {
+        error_output() << "Could not open file: " << path << std::endl;
+        error_exit();
+    }
+    return parse_program(source, path, main_program);
+}
+
+LoadCacheStats &load_cache_stats()
+{
+    static LoadCacheStats stats;
+    return stats;
+}
+
+struct CachedProgram
+{
+    std::shared_ptr<Program> program;
+    time_t mtime;
+    off_t size;
+};
+
+// the same file reached through different relative paths or links has one canonical path
+static std::string canonical_path(const std::string &path)
+{
+    char canonical[PATH_MAX];
+    if (realpath(path.c_str(), canonical) == nullptr)
+    {
+        error_output() << "Could not open file: " << path << std::endl;
+        error_exit();
+    }
+    return canonical;
+}
+
+static std::unordered_map<std::string, CachedProgram> cache;
+static std::mutex cache_mutex;
+static void (*parse_listener)(const ParsedFile &file) = nullptr;
+
+void set_parse_listener(void (*listener)(const ParsedFile &file))
+{
+    parse_listener = listener;
+}
+
+std::shared_ptr<Program> load_cached_program(std::string path)
+{
+    auto canonical = canonical_path(path);
+    struct stat info;
+    if (stat(canonical.c_str(), &info) != 0)
+    {
+        error_output() << "Could not open file: " << path << std::endl;
+        error_exit();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache.find(canonical);
+        if (it != cache.end() && it->second.mtime == info.st_mtime && it->second.size == info.st_size)
+        {
+            load_cache_stats().hits++;
+            return it->second.program;
+        }
+    }
+
+    // parsed without the lock, so workers can parse different files at once. two workers
+    // missing on the same file both parse it, and the last one in stays cached
+    load_cache_stats().misses++;
+    SourceBuffer source;
+    if (!source.load(canonical))
+    {
+        error_output() << "Could not open file: " << path << std::endl;
+        error_exit();
+    }
+
+    // copied before the scanner gets to the buffer
+    ParsedFile file{canonical, info.st_mtime, info.st_size};
+    if (parse_listener != nullptr)
+    {
+        file.text.assign(source.data, source.size);
+    }
+
+    std::shared_ptr<Program> program(parse_program(source, canonical, false));
+    if (parse_listener != nullptr)
+    {
+        parse_listener(file);
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache[canonical] = CachedProgram{program, info.st_mtime, info.st_size};
+    return program;
+}
+
+void cache_program(const ParsedFile &file)
+{
+    SourceBuffer source;
+    source.assign(file.text);
+    std::shared_ptr<Program> program(parse_program(source, file.path, false));
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache[file.path] = CachedProgram{program, file.mtime, file.size};
+}
+
+static bool memoize_all = false;
+static std::unordered_set<std::string> memoized_files;
+
+void memoize_all_loads()
+{
+    memoize_all = true;
+}
+
+void memoize_loads_of(std::string path)
+{
+    memoized_files.insert(canonical_path(path));
+}
+
+// appends a byte string that is equal for equal values. arrays are written out element by
+// element, so mutating an argument after the load can't change a stored key. functions have
+// no key, since a closure can see state that isn't in its value
+static bool append_key(std::string &key, const Value &value)
+{
+    key += (char)value.type;
+    switch (value.type)
+    {
+    case MyType::MYINT:
+        key.append((const char *)&value.int_value, sizeof(value.int_value));
+        return true;
+    case MyType::MYFLOAT:
+        key.append((const char *)&value.float_value, sizeof(value.float_value));
+        return true;
+    case MyType::MYBOOL:
+        key += (char)value.bool_value;
+        return true;
+    case MyType::MYSTRING:
+    {
+        size_t length = value.length();
+        key.append((const char *)&length, sizeof(length));
+        key.append(value.chars(), length);
+        return true;
+    }
+    case MyType::MYARRAY:
+    {
+        // a range keys the same as the array it stands for
+        auto array = value.array;
+        size_t count = array->size();
+        key.append((const char *)&count, sizeof(count));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!append_key(key, (*array)[(int)i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case MyType::MYNONE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct MemoizedTree
+{
+    std::shared_ptr<Program> program; // the tree is only valid while the file is unchanged
+    LoadedTree tree;
+    std::string output; // what the load printed, printed again by every load that reuses it
+};
+
+// passes everything on to out and keeps a copy. the copy isn't printed afterwards, so what a
+// load printed before an error still comes out ahead of it
+struct CopyingBuffer : std::streambuf
+{
+    std::ostream &out;
+    std::string copy;
+
+    CopyingBuffer(std::ostream &out) : out(out) {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+        {
+            copy += (char)c;
+            out.put((char)c);
+        }
+        return c;
+    }
+
+    std::streamsize xsputn(const char *chars, std::streamsize count) override
+    {
+        copy.append(chars, count);
+        out.write(chars, count);
+        return count;
+    }
+
+    int sync() override
+    {
+        out.flush();
+        return 0;
+    }
+};
+
+LoadedTree load_tree(std::string path, std::vector<Value> inputs, LoadEvaluator evaluate)
+{
+    static std::unordered_map<std::string, MemoizedTree> trees;
+    static std::mutex mutex;
+
+    // every evaluator nests a load natively, so a file that loads itself runs out of stack
+    if (native_stack_low())
+    {
+        error_output() << "Loads nest too deeply: the stack filled up loading " << path << std::endl;
+        error_exit();
+    }
+
+    auto canonical = canonical_path(path);
+    auto program = load_cached_program(canonical);
+
+    bool memoize = memoize_all || memoized_files.count(canonical) > 0;
+    std::string key = canonical + '\0';
+    if (memoize)
+    {
+        for (auto &input : inputs)
+        {
+            memoize = memoize && append_key(key, input);
+        }
+    }
+
+    if (!memoize)
+    {
+        return evaluate(program.get(), inputs);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = trees.find(key);
+        if (it != trees.end() && it->second.program == program)
+        {
+            load_cache_stats().trees_reused++;
+            *StandardLib::output() << it->second.output;
+            return it->second.tree;
+        }
+    }
+
+    auto saved = StandardLib::output();
+    CopyingBuffer printed(*saved);
+    std::ostream copying(&printed);
+    StandardLib::output() = &copying;
+    auto tree = evaluate(program.get(), inputs);
+    StandardLib::output() = saved;
+
+    // two workers can miss on the same key at once. both trees are equal, so either may stay
+    std::lock_guard<std::mutex> lock(mutex);
+    trees[key] = MemoizedTree{program, tree, printed.copy};
+    return tree;
+}
+
+static int jobs = 1;
+
+void set_load_jobs(int count)
+{
+    jobs = count < 1 ? 1 : count;
+}
+
+int load_jobs()
+{
+    return jobs;
+}
+
+// a fixed set of worker threads shared by every run of loads. a thread waiting for its run
+// takes queued tasks itself instead of blocking, so loads nested inside a worker can't
+// deadlock the pool by waiting for threads that are all waiting too
+struct LoadPool
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+
+    LoadPool(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            // loads run the interpreter right on the worker, so it gets the interpreter's stack
+            workers.push_back(std::thread([this]()
+                                          { on_deep_stack([this]()
+                                                          { work(); }); }));
+        }
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            if (tasks.empty())
+            {
+                changed.wait(lock);
+                continue;
+            }
+
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    void run(std::vector<std::function<void()>> &run_tasks)
+    {
+        size_t remaining = run_tasks.size();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto &task : run_tasks)
+        {
+            tasks.push_back([this, &task, &remaining]()
+                            {
+                task();
+                std::lock_guard<std::mutex> lock(mutex);
+                remaining--;
+                changed.notify_all(); });
+        }
+        changed.notify_all();
+
+        while (remaining > 0)
+        {
+            if (tasks.empty())
+            {
+                changed.wait(lock);
+                continue;
+            }
+
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+};
+
+bool shares_state(const std::vector<Value> &inputs)
+{
+    for (auto &input : inputs)
+    {
+        if (input.type == MyType::MYARRAY || input.type == MyType::MYFUNCTION)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a copy that shares no reference counted object with value, so the copy can move to another
+// thread. interned strings are never counted and stay shared
+static void isolate(Value &value)
+{
+    if (value.is_heap_string() && !value.string_value->interned)
+    {
+        value = Value(value.str());
+    }
+}
+
+void run_loads(std::vector<LoadJob> &loads, LoadEvaluator evaluate)
+{
+    // runs on a worker, or on this thread for loads that can't leave it. an error stops only
+    // this load, and waits in it with what the load printed before it
+    auto run_load = [evaluate](LoadJob &load)
+    {
+        auto saved = StandardLib::output();
+        std::ostringstream out;
+        StandardLib::output() = &out;
+        load.error = catch_errors([&]()
+                                  { load.tree = load_tree(load.path, load.inputs, evaluate); });
+        load.output = out.str();
+        StandardLib::output() = saved;
+    };
+
+    std::vector<std::function<void()>> tasks;
+    std::vector<LoadJob *> local;
+    for (auto &load : loads)
+    {
+        if (jobs > 1 && !shares_state(load.inputs))
+        {
+            for (auto &input : load.inputs)
+            {
+                isolate(input);
+            }
+            tasks.push_back([&run_load, &load]()
+                            { run_load(load); });
+        }
+        else
+        {
+            local.push_back(&load);
+        }
+    }
+
+    if (!tasks.empty())
+    {
+        // this thread helps with the run, so the pool only needs the other jobs - 1 threads
+        static LoadPool *pool = new LoadPool(jobs - 1);
+        pool->run(tasks);
+    }
+    for (auto load : local)
+    {
+        run_load(*load);
+    }
+
+    auto &out = *StandardLib::output();
+    for (auto &load : loads)
+    {
+        out << load.before << load.output;
+        if (!load.error.empty())
+        {
+            // reported from here, after everything printed before it, as it would be had the
+            // loads run in turn. the loads after it are dropped
+            error_output() << load.error << std::endl;
+            error_exit();
+        }
+    }
+}
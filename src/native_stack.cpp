@@ -0,0 +1,83 @@
+#include "native_stack.hpp"
+#include <exception>
+#include <pthread.h>
+#include "error_exit.hpp"
+#include "standard_lib.hpp"
+
+// left free below the deepest call, for whatever one call level nests natively
+static const size_t STACK_RESERVE = 1 << 20;
+
+static thread_local bool deep = false;
+static thread_local char *stack_low = nullptr; // the lowest address this thread may use
+
+struct DeepTask
+{
+    const std::function<void()> *body;
+    std::ostream *output;
+    ErrorHandling errors;
+    std::exception_ptr thrown; // rethrown on the waiting thread, so an error unwinds to its catch_errors
+};
+
+static void *run_deep(void *argument)
+{
+    auto task = (DeepTask *)argument;
+    deep = true;
+    StandardLib::output() = task->output;
+    set_error_handling(task->errors);
+    try
+    {
+        (*task->body)();
+    }
+    catch (...)
+    {
+        task->thrown = std::current_exception();
+    }
+    return nullptr;
+}
+
+void on_deep_stack(const std::function<void()> &body)
+{
+    if (deep)
+    {
+        body();
+        return;
+    }
+
+    DeepTask task{&body, StandardLib::output(), error_handling(), nullptr};
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    bool started = pthread_attr_setstacksize(&attributes, DEEP_STACK_BYTES) == 0 &&
+                   pthread_create(&thread, &attributes, run_deep, &task) == 0;
+    pthread_attr_destroy(&attributes);
+
+    if (!started)
+    {
+        body();
+        return;
+    }
+    pthread_join(thread, nullptr);
+    if (task.thrown)
+    {
+        std::rethrow_exception(task.thrown);
+    }
+}
+
+bool native_stack_low()
+{
+    char here;
+    if (stack_low == nullptr)
+    {
+        pthread_attr_t attributes;
+        void *address = nullptr;
+        size_t size = 0;
+        if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+        {
+            pthread_attr_getstack(&attributes, &address, &size);
+            pthread_attr_destroy(&attributes);
+        }
+        // a stack this thread can't find is taken to be the 8MB a thread gets by default
+        stack_low = address != nullptr ? (char *)address : &here - ((size_t)8 << 20);
+    }
+    return (size_t)(&here - stack_low) < STACK_RESERVE;
+}
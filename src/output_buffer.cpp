@@ -0,0 +1,110 @@
+#include "output_buffer.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+OutputBuffer::OutputBuffer(int fd, size_t size) : fd(fd), buffer(size)
+{
+    setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    sync();
+}
+
+bool OutputBuffer::write_all(const char *chars, size_t count)
+{
+    while (count > 0)
+    {
+        auto written = ::write(fd, chars, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        chars += written;
+        count -= written;
+    }
+    return true;
+}
+
+bool OutputBuffer::drain()
+{
+    bool ok = write_all(pbase(), pptr() - pbase());
+    setp(buffer.data(), buffer.data() + buffer.size());
+    return ok;
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type c)
+{
+    if (!drain())
+    {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize OutputBuffer::xsputn(const char *chars, std::streamsize count)
+{
+    if (count <= epptr() - pptr())
+    {
+        traits_type::copy(pptr(), chars, count);
+        pbump(count);
+        return count;
+    }
+
+    if (!drain())
+    {
+        return 0;
+    }
+    if ((size_t)count >= buffer.size())
+    {
+        return write_all(chars, count) ? count : 0;
+    }
+    traits_type::copy(pptr(), chars, count);
+    pbump(count);
+    return count;
+}
+
+int OutputBuffer::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pptr() == pbase())
+    {
+        return 0;
+    }
+    return drain() ? 0 : -1;
+}
+
+Output::Output(int fd) : std::ostream(nullptr), buffer(fd), fd(fd)
+{
+    rdbuf(&buffer);
+}
+
+Output::~Output()
+{
+    buffer.pubsync();
+    if (fd > STDERR_FILENO)
+    {
+        close(fd);
+    }
+}
+
+Output *Output::create(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    return new Output(fd);
+}
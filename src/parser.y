@@ -1,40 +1,55 @@
+%code requires {
+    #include "parse_context.hpp"
+    #include "source_buffer.hpp"
+}
+
 %{
     #include "ast_nodes/ast.hpp"
+    #include "error_exit.hpp"
     #include <iostream>
     #include <string>
     #include <memory>
 
-    void yyerror(Program** program, const char* s);
-    void ros_parse(Program** program, const char* code);
-
-    extern int yylex();
-    extern void scanner_destroy();
-    extern void scanner_init(const char* code);
+    // the statement lists are right recursive, so every statement of a block stays on the
+    // parser stack until the block ends. the default limit of 10000 caps a file at a few
+    // thousand top level statements
+    #define YYMAXDEPTH 10000000
 %}
 
-%parse-param { Program** program }
+%define api.pure full
+%lex-param { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { ParseContext* context }
 
 %union {
     int intval;
     float floatval;
     bool boolval;
-    char* strval;
-    char* id;
-    List<Expr>* expr_list;
+    String* strval;
+    String* id;
+    ListBuilder<Expr>* expr_list;
     Expr* expr;
-    List<Stmt>* stmt_list;
+    ListBuilder<Stmt>* stmt_list;
     Stmt* stmt;
     IdentifierType* identifier_type;
-    List<IdentifierType>* identifier_type_list;
+    ListBuilder<IdentifierType>* identifier_type_list;
     Type* type;
     BlockStmt* block_stmt;
     Program* program;
     TreeNode* tree_node;
-    List<TreeNode>* tree_node_list;
+    ListBuilder<TreeNode>* tree_node_list;
     Input* input;
-    List<Input>* input_list;
+    ListBuilder<Input>* input_list;
     InputDefault* input_default;
-    List<Type>* type_list;
+    ListBuilder<Type>* type_list;
+}
+
+%code {
+    int yylex(YYSTYPE* yylval, yyscan_t scanner);
+    void yyerror(yyscan_t scanner, ParseContext* context, const char* s);
+
+    int yylex_init_extra(ParseContext* context, yyscan_t* scanner);
+    int yylex_destroy(yyscan_t scanner);
+    struct yy_buffer_state* yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
 }
 
 %token <intval> INT_LITERAL
@@ -113,18 +128,18 @@
 %%
 
 program:
-    input_list stmt_list tree  { *program = new Program(std::move($1->items), std::move($2->items), $3); }
+    input_list stmt_list tree  { context->program = new Program($1->build(*context->arena), $2->build(*context->arena), $3); }
     ;
 
 input_list:
-    input_list input { $1->add($2); $$ = $1; }
-    | input { $$ = new List<Input>({$1}); }
-    | { $$ = new List<Input>(); }
+    input_list input { $$ = $1->append(*context->arena, $2); }
+    | input { $$ = context->node<ListBuilder<Input>>()->append(*context->arena, $1); }
+    | { $$ = context->node<ListBuilder<Input>>(); }
     ;
 
 input:
-    INPUT IDENTIFIER COLON type EQUAL expr NEW_LINE { $$ = new InputDefault($2, $4, $6); }
-    | INPUT IDENTIFIER COLON type NEW_LINE { $$ = new Input($2, $4); }
+    INPUT IDENTIFIER COLON type EQUAL expr NEW_LINE { $$ = context->node<InputDefault>($2, $4, $6); }
+    | INPUT IDENTIFIER COLON type NEW_LINE { $$ = context->node<Input>($2, $4); }
     ;
 
 tree:
@@ -136,19 +151,19 @@ tree:
     ;
 
 and_node:
-    AND COLON NEW_LINE children {  $$ = new AndNode(std::move($4->items)); }
+    AND COLON NEW_LINE children {  $$ = context->node<AndNode>($4->build(*context->arena)); }
     ;
 
 or_node:
-    OR COLON NEW_LINE children { $$ = new OrNode(std::move($4->items)); }
+    OR COLON NEW_LINE children { $$ = context->node<OrNode>($4->build(*context->arena)); }
     ;
 
 then_node:
-    THEN COLON NEW_LINE children { $$ = new ThenNode(std::move($4->items)); }
+    THEN COLON NEW_LINE children { $$ = context->node<ThenNode>($4->build(*context->arena)); }
     ;
 
 behavior_node:
-    IDENTIFIER LPAREN arg_list RPAREN  {  $$ = new BehaviorNode($1, std::move($3->items)); }
+    IDENTIFIER LPAREN arg_list RPAREN  {  $$ = context->node<BehaviorNode>($1, $3->build(*context->arena)); }
 
 pseudo_node:
     at_if_stmt
@@ -158,19 +173,19 @@ pseudo_node:
     ;
 
 at_load_stmt:
-    AT_LOAD LPAREN arg_list RPAREN NEW_LINE { $$ = new AtLoadNode(std::move($3->items)); }
+    AT_LOAD LPAREN arg_list RPAREN NEW_LINE { $$ = context->node<AtLoadNode>($3->build(*context->arena)); }
     ;
 
 at_if_stmt:
-    AT_IF expr COLON NEW_LINE children { $$ = new AtIfNode($2, std::move($5->items)); }
+    AT_IF expr COLON NEW_LINE children { $$ = context->node<AtIfNode>($2, $5->build(*context->arena)); }
     ;
 
 at_if_else_stmt:
-    AT_IF expr COLON NEW_LINE children AT_ELSE COLON NEW_LINE children { $$ = new AtIfElseNode($2, std::move($5->items), std::move($9->items)); }
+    AT_IF expr COLON NEW_LINE children AT_ELSE COLON NEW_LINE children { $$ = context->node<AtIfElseNode>($2, $5->build(*context->arena), $9->build(*context->arena)); }
     ;
 
 at_for_stmt:
-    AT_FOR IDENTIFIER IN expr COLON NEW_LINE children { $$ = new AtForNode($2, $4, std::move($7->items)); }
+    AT_FOR IDENTIFIER IN expr COLON NEW_LINE children { $$ = context->node<AtForNode>($2, $4, $7->build(*context->arena)); }
     ;
 
 children:
@@ -179,15 +194,15 @@ children:
     ;
 
 node_list:
-    tree {  $$ = new List<TreeNode>({$1}); }
-    | tree node_list { $2->add($1); $$ = $2; }
-    |
+    tree {  $$ = context->node<ListBuilder<TreeNode>>()->append(*context->arena, $1); }
+    | tree node_list { $$ = $2->append(*context->arena, $1); }
+    | { $$ = context->node<ListBuilder<TreeNode>>(); }
     ; 
 
 stmt_list:
-    stmt { $$ = new List<Stmt>({$1}); }
-    | stmt stmt_list { $2->add($1); $$ = $2; }
-    | { $$ = new List<Stmt>(); }
+    stmt { $$ = context->node<ListBuilder<Stmt>>()->append(*context->arena, $1); }
+    | stmt stmt_list { $$ = $2->append(*context->arena, $1); }
+    | { $$ = context->node<ListBuilder<Stmt>>(); }
     ;
 
 stmt:
@@ -204,68 +219,68 @@ stmt:
     ;
 
 for_in_stmt:
-    FOR IDENTIFIER IN expr COLON NEW_LINE block  { $$ = new ForInStmt($2, $4, $7); }
+    FOR IDENTIFIER IN expr COLON NEW_LINE block  { $$ = context->node<ForInStmt>($2, $4, $7); }
     ;
 
 if_stmt:
-    IF expr COLON NEW_LINE block  { $$ = new IfStmt($2, $5); }
-    | IF expr COLON NEW_LINE block ELSE COLON NEW_LINE block  { $$ = new IfElseStmt($2, $5, $9); }
+    IF expr COLON NEW_LINE block  { $$ = context->node<IfStmt>($2, $5); }
+    | IF expr COLON NEW_LINE block ELSE COLON NEW_LINE block  { $$ = context->node<IfElseStmt>($2, $5, $9); }
     ;
 
 while_stmt:
-    WHILE expr COLON NEW_LINE block { $$ = new WhileStmt($2, $5); }
+    WHILE expr COLON NEW_LINE block { $$ = context->node<WhileStmt>($2, $5); }
     ;
 
 break_stmt:
-    BREAK { $$ = new BreakStmt(); }
+    BREAK { $$ = context->node<BreakStmt>(); }
     ;
 
 continue_stmt:
-    CONTINUE { $$ = new ContinueStmt(); }
+    CONTINUE { $$ = context->node<ContinueStmt>(); }
     ;
 
 fn_decl:
-    FUN IDENTIFIER LPAREN param_list RPAREN TYPE_ARROW type COLON NEW_LINE block { $$ = new FnDecl($2, std::move($4->items), $7, $10); }
+    FUN IDENTIFIER LPAREN param_list RPAREN TYPE_ARROW type COLON NEW_LINE block { $$ = context->node<FnDecl>($2, $4->build(*context->arena), $7, $10); }
     ;
 
 param_list:
-    IDENTIFIER COLON type { $$ = new List<IdentifierType>({new IdentifierType($1, $3)}); }
-    | IDENTIFIER COLON type COMMA param_list { $5->add(new IdentifierType($1, $3)); $$ = $5; }
-    | { $$ = new List<IdentifierType>(); }
+    IDENTIFIER COLON type { $$ = context->node<ListBuilder<IdentifierType>>()->append(*context->arena, context->node<IdentifierType>($1, $3)); }
+    | IDENTIFIER COLON type COMMA param_list { $$ = $5->append(*context->arena, context->node<IdentifierType>($1, $3)); }
+    | { $$ = context->node<ListBuilder<IdentifierType>>(); }
     ;
 
 return_stmt:
-    RETURN expr { $$ = new ReturnStmt($2); }
-    | RETURN { $$ = new ReturnStmt(); }
+    RETURN expr { $$ = context->node<ReturnStmt>($2); }
+    | RETURN { $$ = context->node<ReturnStmt>(); }
     ;
 
 type: 
     type_identifier 
-    | LPAREN type_list RPAREN type { $$ = new FunctionType(std::move($2->items), $4); }
-    | type LBRACKET RBRACKET { $$ = new ArrayType($1); }
+    | LPAREN type_list RPAREN type { $$ = context->node<FunctionType>($2->build(*context->arena), $4); }
+    | type LBRACKET RBRACKET { $$ = context->node<ArrayType>($1); }
     ;
 
 type_list:
-    type { $$ = new List<Type>({$1}); }
-    | type COMMA type_list { $3->add($1); $$ = $3; }
+    type { $$ = context->node<ListBuilder<Type>>()->append(*context->arena, $1); }
+    | type COMMA type_list { $$ = $3->append(*context->arena, $1); }
     ;
 
 type_identifier:
-    INT { $$ = new PrimitiveType("int"); }
-    | FLOAT { $$ = new PrimitiveType("float"); }
-    | STRING { $$ = new PrimitiveType("string"); }
-    | BOOL { $$ = new PrimitiveType("bool"); }
-    | VOID { $$ = new PrimitiveType("void"); }
-    | NONE { $$ = new PrimitiveType("none"); }
+    INT { $$ = context->node<PrimitiveType>(TYPE_INT); }
+    | FLOAT { $$ = context->node<PrimitiveType>(TYPE_FLOAT); }
+    | STRING { $$ = context->node<PrimitiveType>(TYPE_STRING); }
+    | BOOL { $$ = context->node<PrimitiveType>(TYPE_BOOL); }
+    | VOID { $$ = context->node<PrimitiveType>(TYPE_VOID); }
+    | NONE { $$ = context->node<PrimitiveType>(TYPE_NONE); }
     ;
 
 var_decl:
-    LET IDENTIFIER COLON type EQUAL expr { $$ = new VarDecl($2, $4, $6); }
+    LET IDENTIFIER COLON type EQUAL expr { $$ = context->node<VarDecl>($2, $4, $6); }
     ;
 
 block:
-    INDENT stmt_list DEDENT { $$ = new BlockStmt(std::move($2->items)); }
-    | INDENT stmt_list OUTDENT  { $$ = new BlockStmt(std::move($2->items)); }
+    INDENT stmt_list DEDENT { $$ = context->node<BlockStmt>($2->build(*context->arena)); }
+    | INDENT stmt_list OUTDENT  { $$ = context->node<BlockStmt>($2->build(*context->arena)); }
     ; 
 
 expr:
@@ -273,104 +288,120 @@ expr:
     ;
 
 lambda:
-    LPAREN param_list RPAREN TYPE_ARROW type COLON expr { $$ = new LambdaExpr(std::move($2->items), $5, $7); }
+    LPAREN param_list RPAREN TYPE_ARROW type COLON expr { $$ = context->node<LambdaExpr>($2->build(*context->arena), $5, $7); }
     | assignment
     ;
 
 assignment:
-    IDENTIFIER EQUAL expr { $$ = new AssignExpr($1, $3); }
-    | IDENTIFIER LBRACKET expr RBRACKET EQUAL expr { $$ = new ArrayAssignExpr($1, $3, $6); }
+    IDENTIFIER EQUAL expr { $$ = context->node<AssignExpr>($1, $3); }
+    | IDENTIFIER LBRACKET expr RBRACKET EQUAL expr { $$ = context->node<ArrayAssignExpr>($1, $3, $6); }
     | ternary
     ;
 
 ternary:
-    expr QUESTION_MARK expr COLON expr { $$ = new TernaryExpr($1, $3, $5); }
+    expr QUESTION_MARK expr COLON expr { $$ = context->node<TernaryExpr>($1, $3, $5); }
     | or
     ;
 
 or: 
-    or OR and { $$ = new BinaryExpr($1, $3, "or"); }
+    or OR and { $$ = context->node<BinaryExpr>($1, $3, BINARY_OR); }
     | and
     ;
 
 and: 
-    and AND equality { $$ = new BinaryExpr($1, $3, "and"); }
+    and AND equality { $$ = context->node<BinaryExpr>($1, $3, BINARY_AND); }
     | equality
     ;
 
 equality:
-    equality EQUAL_EQUAL comparison { $$ = new BinaryExpr($1, $3, "=="); }
-    | equality BANG_EQUAL comparison { $$ = new BinaryExpr($1, $3, "!="); }
+    equality EQUAL_EQUAL comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_EQ); }
+    | equality BANG_EQUAL comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_NE); }
     | comparison
     ;
 
 comparison:
-    comparison GREATER comparison { $$ = new BinaryExpr($1, $3, ">"); }
-    | comparison LESS comparison { $$ = new BinaryExpr($1, $3, "<"); }
-    | comparison GREATER_EQUAL comparison { $$ = new BinaryExpr($1, $3, ">="); }
-    | comparison LESS_EQUAL comparison { $$ = new BinaryExpr($1, $3, "<="); }
+    comparison GREATER comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_GT); }
+    | comparison LESS comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_LT); }
+    | comparison GREATER_EQUAL comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_GE); }
+    | comparison LESS_EQUAL comparison { $$ = context->node<BinaryExpr>($1, $3, BINARY_LE); }
     | term
     ;
 
 term:
-    factor PLUS term { $$ = new BinaryExpr($1, $3, "+"); }
-    | factor MINUS term { $$ = new BinaryExpr($1, $3, "-"); }
+    factor PLUS term { $$ = context->node<BinaryExpr>($1, $3, BINARY_ADD); }
+    | factor MINUS term { $$ = context->node<BinaryExpr>($1, $3, BINARY_SUB); }
     | factor
     ;
 
 factor:
-    exponent STAR factor { $$ = new BinaryExpr($1, $3, "*"); }
-    | exponent SLASH factor { $$ = new BinaryExpr($1, $3, "/"); }
-    | exponent MOD factor { $$ = new BinaryExpr($1, $3, "%"); }
+    exponent STAR factor { $$ = context->node<BinaryExpr>($1, $3, BINARY_MUL); }
+    | exponent SLASH factor { $$ = context->node<BinaryExpr>($1, $3, BINARY_DIV); }
+    | exponent MOD factor { $$ = context->node<BinaryExpr>($1, $3, BINARY_MOD); }
     | exponent
     ;
 
 exponent:
-    unary STAR_STAR exponent { $$ = new BinaryExpr($1, $3, "**"); }
+    unary STAR_STAR exponent { $$ = context->node<BinaryExpr>($1, $3, BINARY_POW); }
     | unary
     ;
 
 unary:
-    MINUS unary { $$ = new UnaryExpr($2, "-"); }
-    | NOT unary { $$ = new UnaryExpr($2, "!"); }
+    MINUS unary { $$ = context->node<UnaryExpr>($2, UNARY_NEG); }
+    | NOT unary { $$ = context->node<UnaryExpr>($2, UNARY_NOT); }
     | call
     ;
 
 call:
-    IDENTIFIER LPAREN arg_list RPAREN { $$ = new CallExpr($1, std::move($3->items)); }
-    | call LPAREN arg_list RPAREN { $$ = new CallExpr(dynamic_cast<CallExpr*>($1)->identifier, std::move($3->items)); }
-    | IDENTIFIER LBRACKET expr RBRACKET { $$ = new ArrayAccessExpr($1, $3); }
-    | call LBRACKET expr RBRACKET { $$ = new ArrayAccessExpr(dynamic_cast<ArrayAccessExpr*>($1)->identifier, $3); }
+    IDENTIFIER LPAREN arg_list RPAREN { $$ = context->node<CallExpr>($1, $3->build(*context->arena)); }
+    | call LPAREN arg_list RPAREN { $$ = context->node<CallExpr>(String::intern(dynamic_cast<CallExpr*>($1)->identifier), $3->build(*context->arena)); }
+    | INT LPAREN arg_list RPAREN { $$ = context->node<CallExpr>(String::intern("int"), $3->build(*context->arena)); }
+    | FLOAT LPAREN arg_list RPAREN { $$ = context->node<CallExpr>(String::intern("float"), $3->build(*context->arena)); }
+    | IDENTIFIER LBRACKET expr RBRACKET { $$ = context->node<ArrayAccessExpr>($1, $3); }
+    | call LBRACKET expr RBRACKET { $$ = context->node<ArrayAccessExpr>(String::intern(dynamic_cast<ArrayAccessExpr*>($1)->identifier), $3); }
     | primary
     ;
 
 arg_list:
-    expr { $$ = new List<Expr>({$1}); }
-    | expr COMMA arg_list  { $3->add($1); $$ = $3; }
-    | { $$ = new List<Expr>(); }
+    expr { $$ = context->node<ListBuilder<Expr>>()->append(*context->arena, $1); }
+    | expr COMMA arg_list  { $$ = $3->append(*context->arena, $1); }
+    | { $$ = context->node<ListBuilder<Expr>>(); }
     ;
 
 primary:
-    INT_LITERAL { $$ = new IntLiteral($1); }
-    | FLOAT_LITERAL  { $$ = new FloatLiteral($1); }
-    | STRING_LITERAL  { $$ = new StringLiteral($1); }
-    | BOOL_LITERAL { $$ = new BoolLiteral($1); }
-    | IDENTIFIER  { $$ = new IdentifierExpr($1); }
+    INT_LITERAL { $$ = context->node<IntLiteral>($1); }
+    | FLOAT_LITERAL  { $$ = context->node<FloatLiteral>($1); }
+    | STRING_LITERAL  { $$ = context->node<StringLiteral>($1); }
+    | BOOL_LITERAL { $$ = context->node<BoolLiteral>($1); }
+    | IDENTIFIER  { $$ = context->node<IdentifierExpr>($1); }
     | array
     ;
 
 array:
-    LBRACKET arg_list RBRACKET { $$ = new ArrayLiteral(std::move($2->items)); }
+    LBRACKET arg_list RBRACKET { $$ = context->node<ArrayLiteral>($2->build(*context->arena)); }
     ;
 
 %%
 
-void yyerror(Program** program, const char *s) {
-    std::cerr << "Error: " << s << std::endl;
+void yyerror(yyscan_t scanner, ParseContext* context, const char *s) {
+    error_output() << "Error: " << s << std::endl;
 }
 
-void ros_parse(Program** program, const char* code) {
-    scanner_init(code);
-    yyparse(program);
-    scanner_destroy();
+void ros_parse(Program** program, SourceBuffer& source) {
+    ParseContext context;
+    context.arena = new Arena();
+
+    yyscan_t scanner;
+    yylex_init_extra(&context, &scanner);
+    // scanned in place, NULs included
+    yy_scan_buffer(source.data, source.size + 2, scanner);
+    yyparse(scanner, &context);
+    yylex_destroy(scanner);
+
+    // a failed parse leaves its partial nodes in the arena, so they go with it
+    if (context.program != nullptr) {
+        context.program->arena.reset(context.arena);
+    } else {
+        delete context.arena;
+    }
+    *program = context.program;
 }
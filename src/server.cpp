@@ -0,0 +1,405 @@
+#include "server.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "json.hpp"
+#include "loader.hpp"
+#include "standard_lib.hpp"
+#include "tree_sink.hpp"
+#include "visitors/interpreter.hpp"
+#include "vm/vm.hpp"
+
+// one client. its requests run one at a time, in order
+struct Connection
+{
+    int in;
+    int out;
+    std::string buffer;  // read, but not yet a whole request
+    bool closed = false; // nothing more to read
+
+    // the worker running the current request
+    pid_t worker = -1;
+    int parsed = -1; // the files it parsed. closes when it exits
+    int errors = -1; // its stderr
+    std::string report;
+    std::string error_text;
+
+    Connection(int in, int out) : in(in), out(out) {}
+};
+
+static bool write_all(int fd, const char *chars, size_t count)
+{
+    while (count > 0)
+    {
+        auto written = write(fd, chars, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        chars += written;
+        count -= written;
+    }
+    return true;
+}
+
+static void respond(int fd, const char *status, const std::string &body)
+{
+    auto response = std::string(status) + " " + std::to_string(body.size()) + "\n" + body;
+    write_all(fd, response.data(), response.size());
+}
+
+// reads what is there into text. false at the end of the file, or on an error
+static bool read_some(int fd, std::string &text)
+{
+    char chunk[1 << 16];
+    auto got = read(fd, chunk, sizeof(chunk));
+    if (got < 0 && errno == EINTR)
+    {
+        return true;
+    }
+    if (got <= 0)
+    {
+        return false;
+    }
+    text.append(chunk, got);
+    return true;
+}
+
+// a parsed file as it goes through the pipe: this, then the path, then the text
+struct ParsedHeader
+{
+    uint32_t path_size;
+    uint32_t text_size;
+    int64_t mtime;
+    int64_t size;
+};
+
+static int parsed_fd = -1;
+
+static void report_parse(const ParsedFile &file)
+{
+    // loads on other threads parse too, and a file doesn't fit in one atomic write
+    static std::mutex mutex;
+    ParsedHeader header{(uint32_t)file.path.size(), (uint32_t)file.text.size(), file.mtime, file.size};
+    std::string message((const char *)&header, sizeof(header));
+    message += file.path;
+    message += file.text;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write_all(parsed_fd, message.data(), message.size());
+}
+
+// runs in the worker. anything that goes wrong exits, and the daemon sends the error
+static void handle(const std::string &line, int out, bool interpret)
+{
+    auto request = parse_json(line, "request");
+    auto path = request.get("program");
+    if (path == nullptr || path->kind != Json::JSON_STRING)
+    {
+        std::cerr << "Request needs a program" << std::endl;
+        exit(1);
+    }
+
+    auto emit = request.get("emit");
+    std::string format = emit != nullptr ? emit->string : "text";
+    std::ostringstream body;
+    std::unique_ptr<DHTT::Sink> sink(DHTT::make_sink(format, body));
+    if (sink == nullptr)
+    {
+        std::cerr << "Can't emit " << format << std::endl;
+        exit(1);
+    }
+
+    auto program = load_cached_program(path->string);
+    std::vector<Value> inputs;
+    if (auto given = request.get("inputs"))
+    {
+        inputs = json_inputs(program.get(), *given);
+    }
+
+    DHTT::Tree tree;
+    if (interpret)
+    {
+        Interpreter interpreter;
+        interpreter.evaluate(program.get(), inputs);
+        tree = std::move(interpreter.tree);
+    }
+    else
+    {
+        VM vm;
+        vm.evaluate(program.get(), inputs);
+        tree = std::move(vm.tree);
+    }
+
+    DHTT::emit(tree, *sink);
+    respond(out, "ok", body.str());
+}
+
+static void start(Connection &connection, const std::string &line, int listener, bool interpret)
+{
+    int parsed[2];
+    int errors[2];
+    if (pipe(parsed) != 0 || pipe(errors) != 0)
+    {
+        respond(connection.out, "error", "Could not start a worker\n");
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(parsed[0]);
+        close(errors[0]);
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        dup2(errors[1], STDERR_FILENO);
+        close(errors[1]);
+
+        parsed_fd = parsed[1];
+        set_parse_listener(report_parse);
+
+        // what the program prints is only sent back with an error
+        StandardLib::output() = &std::cerr;
+        handle(line, connection.out, interpret);
+        _exit(0);
+    }
+
+    close(parsed[1]);
+    close(errors[1]);
+    if (pid < 0)
+    {
+        close(parsed[0]);
+        close(errors[0]);
+        respond(connection.out, "error", "Could not start a worker\n");
+        return;
+    }
+
+    connection.worker = pid;
+    connection.parsed = parsed[0];
+    connection.errors = errors[0];
+}
+
+// after the worker has exited
+static void finish(Connection &connection)
+{
+    int status = 0;
+    waitpid(connection.worker, &status, 0);
+    while (read_some(connection.errors, connection.error_text))
+    {
+    }
+    close(connection.parsed);
+    close(connection.errors);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        respond(connection.out, "error", connection.error_text.empty() ? "Worker failed\n" : connection.error_text);
+    }
+
+    // the worker parsed the same text without an error, so parsing it here can't exit. the file
+    // itself isn't read again, since it may have changed since
+    size_t at = 0;
+    ParsedHeader header;
+    while (connection.report.size() - at >= sizeof(header))
+    {
+        memcpy(&header, connection.report.data() + at, sizeof(header));
+        at += sizeof(header);
+        if (connection.report.size() - at < (size_t)header.path_size + header.text_size)
+        {
+            break;
+        }
+
+        ParsedFile file;
+        file.path = connection.report.substr(at, header.path_size);
+        file.text = connection.report.substr(at + header.path_size, header.text_size);
+        file.mtime = header.mtime;
+        file.size = header.size;
+        cache_program(file);
+        at += header.path_size + header.text_size;
+    }
+
+    connection.worker = -1;
+    connection.parsed = -1;
+    connection.errors = -1;
+    connection.report.clear();
+    connection.error_text.clear();
+}
+
+// starts the next request when the connection is idle. false once it has nothing left to do
+static bool next(Connection &connection, int listener, bool interpret)
+{
+    while (connection.worker < 0)
+    {
+        auto end = connection.buffer.find('\n');
+        if (end == std::string::npos && !connection.closed)
+        {
+            return true;
+        }
+        if (end == std::string::npos && connection.buffer.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            return false;
+        }
+
+        auto line = connection.buffer.substr(0, end);
+        connection.buffer.erase(0, end == std::string::npos ? end : end + 1);
+        if (line.find_first_not_of(" \t\r") != std::string::npos)
+        {
+            start(connection, line, listener, interpret);
+        }
+    }
+    return true;
+}
+
+static int listen_on(const char *path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        exit(1);
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        std::cerr << "Could not listen on " << path << ": " << strerror(errno) << std::endl;
+        exit(1);
+    }
+    return fd;
+}
+
+int serve(const char *socket_path, bool interpret)
+{
+    // a client that hangs up early must not take the daemon down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = -1;
+    std::vector<std::unique_ptr<Connection>> connections;
+    if (strcmp(socket_path, "-") == 0)
+    {
+        connections.emplace_back(new Connection(STDIN_FILENO, STDOUT_FILENO));
+    }
+    else
+    {
+        listener = listen_on(socket_path);
+    }
+
+    enum Source
+    {
+        LISTENER,
+        REQUESTS,
+        PARSED,
+        ERRORS,
+    };
+    std::vector<pollfd> fds;
+    std::vector<std::pair<Source, Connection *>> sources;
+
+    while (listener >= 0 || !connections.empty())
+    {
+        fds.clear();
+        sources.clear();
+        auto watch = [&](int fd, Source source, Connection *connection)
+        {
+            fds.push_back(pollfd{fd, POLLIN, 0});
+            sources.push_back({source, connection});
+        };
+
+        if (listener >= 0)
+        {
+            watch(listener, LISTENER, nullptr);
+        }
+        for (auto &connection : connections)
+        {
+            if (connection->worker >= 0)
+            {
+                watch(connection->parsed, PARSED, connection.get());
+                watch(connection->errors, ERRORS, connection.get());
+            }
+            else
+            {
+                watch(connection->in, REQUESTS, connection.get());
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "poll failed: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            auto connection = sources[i].second;
+            switch (sources[i].first)
+            {
+            case LISTENER:
+            {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd >= 0)
+                {
+                    connections.emplace_back(new Connection(fd, fd));
+                }
+                break;
+            }
+            case REQUESTS:
+                connection->closed = !read_some(connection->in, connection->buffer);
+                break;
+            case PARSED:
+                if (!read_some(connection->parsed, connection->report))
+                {
+                    finish(*connection);
+                }
+                break;
+            case ERRORS:
+                read_some(connection->errors, connection->error_text);
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < connections.size();)
+        {
+            auto &connection = *connections[i];
+            if (next(connection, listener, interpret))
+            {
+                i++;
+                continue;
+            }
+
+            if (connection.in != STDIN_FILENO)
+            {
+                close(connection.in);
+            }
+            connections.erase(connections.begin() + i);
+        }
+    }
+    return 0;
+}
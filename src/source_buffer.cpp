@@ -0,0 +1,123 @@
+#include "source_buffer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::~SourceBuffer()
+{
+    if (mapped > 0)
+    {
+        munmap(data, mapped);
+    }
+    else
+    {
+        free(data);
+    }
+}
+
+bool SourceBuffer::load(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    bool loaded = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && map(fd, info.st_size);
+    if (!loaded)
+    {
+        loaded = read_all(fd);
+    }
+
+    close(fd);
+    return loaded;
+}
+
+// the bytes between the end of a file and the end of its last page read as zeros, so when
+// at least two of them are left the NULs come for free. the scanner writes to the buffer
+// while it scans, so the mapping is private and writable
+bool SourceBuffer::map(int fd, size_t file_size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (file_size == 0 || file_size % page > page - 2 || file_size % page == 0)
+    {
+        return false;
+    }
+
+    void *address = mmap(nullptr, file_size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // files without a trailing newline are read instead, since the grammar ends every line
+    // with one and adding it would mean writing past the end of the file
+    if (((char *)address)[file_size - 1] != '\n')
+    {
+        munmap(address, file_size + 2);
+        return false;
+    }
+
+    data = (char *)address;
+    size = file_size;
+    mapped = file_size + 2;
+    return true;
+}
+
+bool SourceBuffer::read_all(int fd)
+{
+    size_t capacity = 64 * 1024;
+    data = (char *)malloc(capacity);
+    size = 0;
+    for (;;)
+    {
+        // room for the newline and the two NULs
+        if (capacity - size < 4)
+        {
+            capacity *= 2;
+            data = (char *)realloc(data, capacity);
+        }
+
+        ssize_t count = read(fd, data + size, capacity - size - 3);
+        if (count < 0)
+        {
+            return false;
+        }
+        if (count == 0)
+        {
+            break;
+        }
+        size += count;
+    }
+
+    if (size > 0 && data[size - 1] != '\n')
+    {
+        data[size++] = '\n';
+    }
+    data[size] = '\0';
+    data[size + 1] = '\0';
+    return true;
+}
+
+void SourceBuffer::assign(const std::string &text)
+{
+    data = (char *)malloc(text.size() + 3);
+    memcpy(data, text.data(), text.size());
+    size = text.size();
+    if (size > 0 && data[size - 1] != '\n')
+    {
+        data[size++] = '\n';
+    }
+    data[size] = '\0';
+    data[size + 1] = '\0';
+}
+
+size_t SourceBuffer::lines() const
+{
+    return std::count(data, data + size, '\n');
+}
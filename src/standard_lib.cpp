@@ -1,56 +1,187 @@
 #include "standard_lib.hpp"
+#include <cstdlib>
+#include <unordered_map>
+#include "error_exit.hpp"
 #include "value/value.hpp"
 
-void StandardLib::print(std::vector<Value> vals)
+std::ostream *&StandardLib::output()
 {
+    thread_local std::ostream *out = &std::cout;
+    return out;
+}
+
+static void expect(bool ok, const char *message)
+{
+    if (!ok)
+    {
+        error_output() << message << std::endl;
+        error_exit();
+    }
+}
 
+static Value print(std::vector<Value> vals)
+{
+    auto &out = *StandardLib::output();
     for (auto it = vals.rbegin(); it != vals.rend(); it++)
     {
-        std::cout << it->to_string() << " ";
+        out << it->to_string() << " ";
     }
 
-    std::cout << std::endl;
+    out << '\n';
+    return Value();
 }
 
-Value StandardLib::range(std::vector<Value> args)
+static Value range(std::vector<Value> args)
 {
+    for (auto &arg : args)
+    {
+        expect(arg.type == MyType::MYINT, "Expected integer arguments to range");
+    }
+
+    // lazy, so counting to n takes no memory
     if (args.size() == 1)
     {
-        if (args[0].type == MyType::MYINT)
-        {
-            std::vector<Value> range;
-            for (int i = 0; i < args[0].int_value; i++)
-            {
-                range.push_back(Value(i));
-            }
-            return Value(new Array(range));
-        }
-        else
-        {
-            std::cerr << "Expected integer argument to range" << std::endl;
-            exit(1);
-        }
+        return Value(new Array(0, args[0].int_value, 1));
     }
-    else if (args.size() == 2)
+    return Value(new Array(args[0].int_value, args[1].int_value, args.size() == 3 ? args[2].int_value : 1));
+}
+
+static Value len(std::vector<Value> args)
+{
+    auto &value = args[0];
+    expect(value.type == MyType::MYSTRING || value.type == MyType::MYARRAY, "Expected string or array argument to len");
+    return Value((int)(value.type == MyType::MYSTRING ? value.length() : value.array->size()));
+}
+
+static Value append(std::vector<Value> args)
+{
+    expect(args[0].type == MyType::MYARRAY, "Expected array argument to append");
+    auto array = args[0].array;
+    array->set(Value((int)array->size()), args[1]);
+    return Value();
+}
+
+static Value extreme(std::vector<Value> &args, BinaryOperator better)
+{
+    Value result = args[0];
+    for (auto &arg : args)
     {
-        if (args[0].type == MyType::MYINT && args[1].type == MyType::MYINT)
-        {
-            std::vector<Value> range;
-            for (int i = args[0].int_value; i < args[1].int_value; i++)
-            {
-                range.push_back(Value(i));
-            }
-            return Value(new Array(range));
-        }
-        else
+        expect(arg.type == result.type && (arg.type == MyType::MYINT || arg.type == MyType::MYFLOAT),
+               "Expected int or float arguments of one type to min and max");
+        if (Value::binary(better, arg, result).bool_value)
         {
-            std::cerr << "Expected integer arguments to range" << std::endl;
-            exit(1);
+            result = arg;
         }
     }
-    else
+    return result;
+}
+
+static Value min(std::vector<Value> args)
+{
+    return extreme(args, BINARY_LT);
+}
+
+static Value max(std::vector<Value> args)
+{
+    return extreme(args, BINARY_GT);
+}
+
+static Value abs(std::vector<Value> args)
+{
+    auto &value = args[0];
+    expect(value.type == MyType::MYINT || value.type == MyType::MYFLOAT, "Expected int or float argument to abs");
+    if (value.type == MyType::MYINT)
+    {
+        return Value(value.int_value < 0 ? -value.int_value : value.int_value);
+    }
+    return Value(std::fabs(value.float_value));
+}
+
+static Value str(std::vector<Value> args)
+{
+    return Value(args[0].to_string());
+}
+
+static Value to_int(std::vector<Value> args)
+{
+    auto &value = args[0];
+    switch (value.type)
     {
-        std::cerr << "Expected 1 or 2 arguments to range" << std::endl;
-        exit(1);
+    case MyType::MYINT:
+        return value;
+    case MyType::MYFLOAT:
+        return Value((int)value.float_value);
+    case MyType::MYBOOL:
+        return Value((int)value.bool_value);
+    case MyType::MYSTRING:
+    {
+        auto chars = value.str();
+        char *end;
+        long result = strtol(chars.c_str(), &end, 10);
+        expect(!chars.empty() && *end == '\0', "Expected a number in the string passed to int");
+        return Value((int)result);
+    }
+    default:
+        expect(false, "Expected int, float, string or bool argument to int");
+        return Value();
     }
-}
\ No newline at end of file
+}
+
+static Value to_float(std::vector<Value> args)
+{
+    auto &value = args[0];
+    switch (value.type)
+    {
+    case MyType::MYINT:
+        return Value((float)value.int_value);
+    case MyType::MYFLOAT:
+        return value;
+    case MyType::MYBOOL:
+        return Value(value.bool_value ? 1.0f : 0.0f);
+    case MyType::MYSTRING:
+    {
+        auto chars = value.str();
+        char *end;
+        float result = strtof(chars.c_str(), &end);
+        expect(!chars.empty() && *end == '\0', "Expected a number in the string passed to float");
+        return Value(result);
+    }
+    default:
+        expect(false, "Expected int, float, string or bool argument to float");
+        return Value();
+    }
+}
+
+static const Native table[] = {
+    {"print", print, 0, -1, {PARAM_ANY}, RESULT_NONE},
+    {"range", range, 1, 3, {PARAM_INT}, RESULT_INT_ARRAY},
+    {"len", len, 1, 1, {PARAM_SEQUENCE}, RESULT_INT},
+    {"append", append, 2, 2, {PARAM_ARRAY, PARAM_ELEMENT}, RESULT_NONE},
+    {"min", min, 2, -1, {PARAM_NUMBER, PARAM_SAME}, RESULT_FIRST},
+    {"max", max, 2, -1, {PARAM_NUMBER, PARAM_SAME}, RESULT_FIRST},
+    {"abs", abs, 1, 1, {PARAM_NUMBER}, RESULT_FIRST},
+    {"str", str, 1, 1, {PARAM_ANY}, RESULT_STRING},
+    {"int", to_int, 1, 1, {PARAM_SCALAR}, RESULT_INT},
+    {"float", to_float, 1, 1, {PARAM_SCALAR}, RESULT_FLOAT},
+};
+
+const Native *StandardLib::native(const std::string &name)
+{
+    static const std::unordered_map<std::string, const Native *> by_name = []()
+    {
+        std::unordered_map<std::string, const Native *> map;
+        for (auto &native : table)
+        {
+            map[native.name] = &native;
+        }
+        return map;
+    }();
+
+    auto it = by_name.find(name);
+    return it == by_name.end() ? nullptr : it->second;
+}
+
+const Native *StandardLib::natives()
+{
+    return table;
+}
@@ -0,0 +1,409 @@
+#include "tree_sink.hpp"
+#include <cstdlib>
+#include "dhtt_reader.hpp"
+
+using namespace DHTT;
+
+void DHTT::emit(const Tree &tree, Sink &sink)
+{
+    for (auto root : tree.roots)
+    {
+        sink.node(tree, root);
+    }
+    sink.finish();
+}
+
+Sink *DHTT::make_sink(const std::string &format, std::ostream &out)
+{
+    if (format == "text")
+    {
+        return new TextSink(out);
+    }
+    if (format == "json")
+    {
+        return new JsonSink(out);
+    }
+    if (format == "yaml")
+    {
+        return new YamlSink(out);
+    }
+    if (format == "bin")
+    {
+        return new BinarySink(out);
+    }
+    return nullptr;
+}
+
+static void indent(std::ostream &out, int spaces)
+{
+    static const char blanks[] = "                                ";
+    for (; spaces > 32; spaces -= 32)
+    {
+        out.write(blanks, 32);
+    }
+    out.write(blanks, spaces);
+}
+
+// a double quoted string, escaped the same way for json and yaml
+static void write_quoted(std::ostream &out, const Tree &tree, NodeId node, size_t i)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t length;
+    auto chars = tree.string(node, i, length);
+    out << '"';
+    for (size_t k = 0; k < length; k++)
+    {
+        unsigned char c = chars[k];
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if (c < 0x20)
+        {
+            out << "\\u00" << hex[c >> 4] << hex[c & 15];
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// a behavior's args as a flow sequence
+static void write_args(std::ostream &out, const Tree &tree, NodeId node)
+{
+    out << '[';
+    for (size_t i = 1; i < tree.string_count(node); i++)
+    {
+        if (i > 1)
+        {
+            out << ", ";
+        }
+        write_quoted(out, tree, node, i);
+    }
+    out << ']';
+}
+
+void TextSink::open_root(Kind kind)
+{
+    out << kind_name(kind) << '\n';
+    in_root = true;
+}
+
+void TextSink::node(const Tree &tree, NodeId node)
+{
+    // an explicit stack, so a deep tree can't overflow the native one
+    stack.push_back({node, in_root ? 1 : 0});
+    while (!stack.empty())
+    {
+        auto top = stack.back();
+        stack.pop_back();
+
+        indent(out, top.second * 2);
+        tree.say_name(top.first, out);
+
+        for (auto child = tree.children_end(top.first); child != tree.children_begin(top.first); child--)
+        {
+            stack.push_back({child[-1], top.second + 1});
+        }
+    }
+}
+
+void TextSink::close_root()
+{
+    in_root = false;
+}
+
+void JsonSink::separate()
+{
+    if (first)
+    {
+        out << (in_root ? "\n" : "[\n");
+        first = false;
+    }
+    else
+    {
+        out << ",\n";
+    }
+}
+
+void JsonSink::open_root(Kind kind)
+{
+    separate();
+    out << "{\"kind\": \"" << kind_name(kind) << "\", \"children\": [";
+    in_root = true;
+    first = true;
+}
+
+void JsonSink::node(const Tree &tree, NodeId node)
+{
+    separate();
+    write(tree, node);
+    while (!stack.empty())
+    {
+        auto &top = stack.back();
+        if (top.next == tree.children_end(top.node))
+        {
+            out << "]}";
+            stack.pop_back();
+            continue;
+        }
+
+        if (top.next != tree.children_begin(top.node))
+        {
+            out << ", ";
+        }
+        write(tree, *top.next++);
+    }
+}
+
+void JsonSink::close_root()
+{
+    out << (first ? "]}" : "\n]}");
+    in_root = false;
+    first = false;
+}
+
+void JsonSink::finish()
+{
+    out << (first ? "[]" : "\n]") << '\n';
+}
+
+// a behavior whole, or the start of a node whose children the caller writes
+void JsonSink::write(const Tree &tree, NodeId node)
+{
+    out << "{\"kind\": \"" << kind_name(tree.kinds[node]) << "\", ";
+    if (tree.kinds[node] == BEHAVIOR)
+    {
+        out << "\"identifier\": ";
+        write_quoted(out, tree, node, 0);
+        out << ", \"args\": ";
+        write_args(out, tree, node);
+        out << '}';
+        return;
+    }
+
+    out << "\"children\": [";
+    stack.push_back({node, tree.children_begin(node)});
+}
+
+void YamlSink::open_root(Kind kind)
+{
+    out << "- kind: " << kind_name(kind) << "\n  children:";
+    in_root = true;
+    first = true;
+}
+
+void YamlSink::node(const Tree &tree, NodeId node)
+{
+    if (in_root && first)
+    {
+        out << '\n';
+    }
+    first = false;
+
+    // each node is an item at 2 * depth spaces, with its keys 2 further in
+    stack.push_back({node, in_root ? 1 : 0});
+    while (!stack.empty())
+    {
+        auto top = stack.back();
+        stack.pop_back();
+        auto kind = tree.kinds[top.first];
+        int keys = top.second * 2 + 2;
+
+        indent(out, keys - 2);
+        out << "- kind: " << kind_name(kind) << '\n';
+        indent(out, keys);
+        if (kind == BEHAVIOR)
+        {
+            out << "identifier: ";
+            write_quoted(out, tree, top.first, 0);
+            out << '\n';
+            indent(out, keys);
+            out << "args: ";
+            write_args(out, tree, top.first);
+            out << '\n';
+            continue;
+        }
+
+        if (tree.children_begin(top.first) == tree.children_end(top.first))
+        {
+            out << "children: []\n";
+            continue;
+        }
+        out << "children:\n";
+        for (auto child = tree.children_end(top.first); child != tree.children_begin(top.first); child--)
+        {
+            stack.push_back({child[-1], top.second + 1});
+        }
+    }
+}
+
+void YamlSink::close_root()
+{
+    if (first)
+    {
+        out << " []\n";
+    }
+    in_root = false;
+    first = false;
+}
+
+void YamlSink::finish()
+{
+    if (first)
+    {
+        out << "[]\n";
+    }
+}
+
+BinarySink::BinarySink(std::ostream &out) : out(out)
+{
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        sections[i] = std::tmpfile();
+        if (sections[i] == nullptr)
+        {
+            std::cerr << "Could not open a temporary file for --emit=bin" << std::endl;
+            exit(1);
+        }
+    }
+
+    // the offset arrays start with a 0 so every node, or string, has an end
+    std::vector<uint32_t> zero{0};
+    write_words(FIRST_CHILD, zero);
+    write_words(FIRST_STRING, zero);
+    write_words(STRING_START, zero);
+}
+
+BinarySink::~BinarySink()
+{
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        fclose(sections[i]);
+    }
+}
+
+void BinarySink::write_words(Section section, const std::vector<uint32_t> &words)
+{
+    fwrite(words.data(), sizeof(uint32_t), words.size(), sections[section]);
+}
+
+void BinarySink::open_root(Kind kind)
+{
+    in_root = true;
+    root_kind = kind;
+}
+
+void BinarySink::node(const Tree &tree, NodeId node)
+{
+    // a subtree is a run of ids ending at its root and starting at its leftmost leaf, since
+    // nodes are numbered as they close. its children and strings are one run each too
+    NodeId first = node;
+    while (tree.first_child[first] != tree.first_child[first + 1])
+    {
+        first = tree.child_ids[tree.first_child[first]];
+    }
+
+    auto child_begin = tree.first_child[first];
+    auto string_begin = tree.first_string[first];
+    auto text_begin = tree.string_start[string_begin];
+    std::vector<uint32_t> words;
+
+    for (NodeId n = first; n <= node; n++)
+    {
+        words.push_back(tree.first_child[n + 1] - child_begin + child_count);
+    }
+    write_words(FIRST_CHILD, words);
+
+    words.clear();
+    for (NodeId n = first; n <= node; n++)
+    {
+        words.push_back(tree.first_string[n + 1] - string_begin + string_count);
+    }
+    write_words(FIRST_STRING, words);
+
+    words.clear();
+    for (auto c = child_begin; c < tree.first_child[node + 1]; c++)
+    {
+        words.push_back(tree.child_ids[c] - first + node_count);
+    }
+    write_words(CHILD_IDS, words);
+
+    words.clear();
+    for (auto s = string_begin; s < tree.first_string[node + 1]; s++)
+    {
+        words.push_back(tree.string_start[s + 1] - text_begin + text_size);
+    }
+    write_words(STRING_START, words);
+
+    auto text_end = tree.string_start[tree.first_string[node + 1]];
+    fwrite(tree.kinds.data() + first, 1, node - first + 1, sections[KINDS]);
+    fwrite(tree.text.data() + text_begin, 1, text_end - text_begin, sections[TEXT]);
+
+    NodeId id = node - first + node_count;
+    (in_root ? root_children : roots).push_back(id);
+
+    node_count += node - first + 1;
+    child_count += tree.first_child[node + 1] - child_begin;
+    string_count += tree.first_string[node + 1] - string_begin;
+    text_size += text_end - text_begin;
+}
+
+void BinarySink::close_root()
+{
+    write_words(CHILD_IDS, root_children);
+    child_count += root_children.size();
+    root_children.clear();
+
+    write_words(FIRST_CHILD, std::vector<uint32_t>{child_count});
+    write_words(FIRST_STRING, std::vector<uint32_t>{string_count});
+    fwrite(&root_kind, 1, 1, sections[KINDS]);
+    roots.push_back(node_count++);
+    in_root = false;
+}
+
+static void write_padding(std::ostream &out, size_t bytes)
+{
+    static const char padding[4] = {0, 0, 0, 0};
+    out.write(padding, (4 - bytes % 4) % 4);
+}
+
+void BinarySink::finish()
+{
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, 4);
+    header.version = BINARY_VERSION;
+    header.node_count = node_count;
+    header.child_count = child_count;
+    header.string_count = string_count;
+    header.root_count = roots.size();
+    header.text_size = text_size;
+    header.reserved = 0;
+    out.write((const char *)&header, sizeof(header));
+
+    // in the reader's order, with the roots in between
+    auto copy = [&](Section section)
+    {
+        char buffer[1 << 16];
+        size_t bytes = 0;
+        size_t got;
+        rewind(sections[section]);
+        while ((got = fread(buffer, 1, sizeof(buffer), sections[section])) > 0)
+        {
+            out.write(buffer, got);
+            bytes += got;
+        }
+        write_padding(out, bytes);
+    };
+
+    copy(FIRST_CHILD);
+    copy(FIRST_STRING);
+    copy(CHILD_IDS);
+    copy(STRING_START);
+    out.write((const char *)roots.data(), roots.size() * sizeof(NodeId));
+    copy(KINDS);
+    copy(TEXT);
+    out.flush();
+}
@@ -1,7 +1,40 @@
+#include <climits>
 #include "value/value.hpp"
+#include "error_exit.hpp"
+
+Array::Array(std::vector<Value> elements) : elements(std::move(elements))
+{
+    set_bytes(sizeof(Array) + this->elements.capacity() * sizeof(Value));
+}
+
+Array::Array(int start, int stop, int step) : lazy(true), start(start), stop(stop), step(step)
+{
+    if (step == 0)
+    {
+        error_output() << "range step must not be zero" << std::endl;
+        error_exit();
+    }
+
+    // widened, so bounds near the ends of int can't overflow. the count itself has to fit an
+    // int, like the index of any other array
+    long long span = step > 0 ? (long long)stop - start : (long long)start - stop;
+    long long stride = step > 0 ? step : -(long long)step;
+    long long elements = span > 0 ? (span + stride - 1) / stride : 0;
+    if (elements > INT_MAX)
+    {
+        error_output() << "range(" << start << ", " << stop << ", " << step << ") has more than " << INT_MAX << " elements" << std::endl;
+        error_exit();
+    }
+    count = (int)elements;
+    set_bytes(sizeof(Array));
+}
 
 Value Array::operator[](int index)
 {
+    if (lazy)
+    {
+        return Value(at(index));
+    }
     return elements[index];
 }
 
@@ -9,25 +42,48 @@ Value Array::operator[](Value index)
 {
     if (index.type != MyType::MYINT)
     {
-        std::cerr << "Array index must be an integer" << std::endl;
-        exit(1);
+        error_output() << "Array index must be an integer" << std::endl;
+        error_exit();
+    }
+
+    if (lazy && (index.int_value < 0 || index.int_value >= count))
+    {
+        error_output() << "Array index out of range" << std::endl;
+        error_exit();
     }
 
-    return elements[index.int_value];
+    return (*this)[index.int_value];
 }
 
 void Array::set(Value index, Value value)
 {
     if (index.type != MyType::MYINT)
     {
-        std::cerr << "Array index must be an integer" << std::endl;
-        exit(1);
+        error_output() << "Array index must be an integer" << std::endl;
+        error_exit();
     }
 
+    materialize();
     if (index.int_value < 0 || index.int_value >= elements.size())
     {
         elements.resize(index.int_value + 1, 0);
+        set_bytes(sizeof(Array) + elements.capacity() * sizeof(Value));
     }
 
     elements[index.int_value] = value;
-}
\ No newline at end of file
+}
+
+std::vector<Value> &Array::materialize()
+{
+    if (lazy)
+    {
+        lazy = false;
+        elements.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            elements.push_back(Value(at(i)));
+        }
+        set_bytes(sizeof(Array) + elements.capacity() * sizeof(Value));
+    }
+    return elements;
+}
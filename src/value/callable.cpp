@@ -1,22 +1,96 @@
 #include "value/callable.hpp"
+#include "error_exit.hpp"
+#include "native_stack.hpp"
 #include "visitors/interpreter.hpp"
+#include "vm/chunk.hpp"
+
+static int call_depth_limit = 0;
+
+void set_max_call_depth(int depth)
+{
+    call_depth_limit = depth;
+}
+
+int max_call_depth()
+{
+    return call_depth_limit > 0 ? call_depth_limit : DEFAULT_MAX_CALL_DEPTH;
+}
+
+Callable::Callable(FunctionProto *proto) : proto(proto)
+{
+    captures.reserve(proto->captures.size());
+    set_bytes(sizeof(Callable) + captures.capacity() * sizeof(Upvalue *));
+}
+
+Callable::~Callable()
+{
+    for (auto capture : captures)
+    {
+        capture->release();
+    }
+}
 
 void Callable::call(Interpreter *interpreter, std::vector<Value> args)
 {
-    interpreter->in_new_scope([&]()
-                              {
-    for (int i = 0; i < args.size(); i++)
+    int limit = max_call_depth();
+    if (++interpreter->call_depth > limit)
     {
-        interpreter->env.set(this->params[i]->identifier, args[i]);
+        error_output() << "Maximum call depth of " << limit << " exceeded" << std::endl;
+        error_exit();
     }
+    if (native_stack_low())
+    {
+        error_output() << "Maximum call depth exceeded: the interpreter's stack filled up after " << interpreter->call_depth - 1 << " calls" << std::endl;
+        error_exit();
+    }
+
+    auto saved = interpreter->env.frame;
 
-    try
+    // a tail call replaces the running function, so it loops here instead of nesting
+    Value tail_callee; // holds the function a tail call switched to
+    Callable *callable = this;
+    for (;;)
     {
-        this->block->accept(interpreter);
+        // the body sees the scope the function was defined in, not the caller's
+        interpreter->env.frame = callable->closure;
+
+        interpreter->in_new_scope([&]()
+                                  {
+        for (int i = 0; i < args.size(); i++)
+        {
+            interpreter->env.define(i, args[i]);
+        }
+
+        if (callable->block != nullptr)
+        {
+            callable->block->accept(interpreter);
+        }
+        else
+        {
+            // the body gets a scope of its own, as if it were a block holding one return
+            interpreter->in_new_scope([&]()
+                                      { callable->expr->accept(interpreter); });
+            interpreter->completion = Interpreter::RETURNING;
+        } });
+
+        if (!interpreter->tail_calling)
+        {
+            break;
+        }
+
+        interpreter->tail_calling = false;
+        interpreter->completion = Interpreter::COMPLETE;
+        tail_callee = std::move(interpreter->tail_callee);
+        args = std::move(interpreter->tail_args);
+        callable = tail_callee.callable;
     }
-    catch (ReturnException e)
+
+    // a return stops at the function boundary
+    if (interpreter->completion == Interpreter::RETURNING)
     {
-        interpreter->env.pop_env();
-        return;
-    } });
-}
\ No newline at end of file
+        interpreter->completion = Interpreter::COMPLETE;
+    }
+
+    interpreter->env.frame = saved;
+    interpreter->call_depth--;
+}
@@ -0,0 +1,642 @@
+#include <algorithm>
+#include "vm/vm.hpp"
+#include "error_exit.hpp"
+#include "visitors/compiler.hpp"
+#include "standard_lib.hpp"
+#include "loader.hpp"
+#include "native_stack.hpp"
+#include "visitors/type_checker.hpp"
+
+static inline void set_int(Value &value, int result)
+{
+    value.release();
+    value.type = MyType::MYINT;
+    value.int_value = result;
+}
+
+static inline void set_float(Value &value, float result)
+{
+    value.release();
+    value.type = MyType::MYFLOAT;
+    value.float_value = result;
+}
+
+static inline void set_bool(Value &value, bool result)
+{
+    value.release();
+    value.type = MyType::MYBOOL;
+    value.bool_value = result;
+}
+
+void VM::evaluate(Program *program)
+{
+    evaluate(program, std::vector<Value>());
+}
+
+void VM::evaluate(Program *program, std::vector<Value> inputs)
+{
+    check_inputs(program, inputs);
+
+    {
+        // a cached program is run by every @load of its file, so it is only compiled once
+        std::lock_guard<std::mutex> lock(program->compile_mutex);
+        if (program->compiled == nullptr)
+        {
+            Compiler compiler;
+            program->compiled = compiler.compile(program);
+        }
+        this->program = program->compiled;
+    }
+
+    auto &names = this->program->globals;
+    globals.assign(names.size(), Value());
+    defined.assign(names.size(), false);
+    natives.clear();
+    for (auto &name : names)
+    {
+        natives.push_back(StandardLib::native(name));
+    }
+
+    auto &slots = this->program->input_slots;
+    for (size_t i = 0; i < inputs.size() && i < slots.size(); i++)
+    {
+        if (!uses_default(program->inputs[i], inputs, i))
+        {
+            globals[slots[i]] = inputs[i];
+            defined[slots[i]] = true;
+        }
+    }
+
+    // frames live on the heap, but every @load nests another run natively
+    on_deep_stack([this]()
+                  { run(); });
+}
+
+void VM::error(std::string message)
+{
+    error_output() << message << std::endl;
+    error_exit();
+}
+
+// each loaded program gets a VM of its own
+static LoadedTree evaluate_load(Program *program, std::vector<Value> inputs)
+{
+    VM vm;
+    vm.evaluate(program, inputs);
+    return std::make_shared<const DHTT::Tree>(std::move(vm.tree));
+}
+
+void VM::load(std::vector<Value> args, bool more_follow)
+{
+    if (args.size() < 1 || args[0].type != MyType::MYSTRING)
+    {
+        error("Expected string value as first argument to load");
+    }
+
+    std::vector<Value> inputs(args.begin() + 1, args.end());
+    if (load_jobs() <= 1)
+    {
+        tree.splice(*load_tree(args[0].str(), inputs, evaluate_load));
+        return;
+    }
+
+    // with --jobs, a run of sibling loads is queued and evaluated together at its last load,
+    // or at a load that shares state, before the args after it are evaluated
+    more_follow = more_follow && !shares_state(inputs);
+    if (queued_loads.empty() && more_follow)
+    {
+        saved_output = StandardLib::output();
+        StandardLib::output() = &between_loads;
+    }
+    queued_loads.push_back(LoadJob{args[0].str(), inputs, between_loads.str()});
+    between_loads.str("");
+    if (more_follow)
+    {
+        return;
+    }
+
+    if (saved_output != nullptr)
+    {
+        StandardLib::output() = saved_output;
+        saved_output = nullptr;
+    }
+
+    std::vector<LoadJob> loads;
+    loads.swap(queued_loads);
+    run_loads(loads, evaluate_load);
+    for (auto &load : loads)
+    {
+        tree.splice(*load.tree);
+    }
+}
+
+// the open capture of a register, shared with every closure that captured it before
+Upvalue *VM::capture(size_t slot)
+{
+    auto it = open_captures.end();
+    while (it != open_captures.begin() && it[-1]->slot >= slot)
+    {
+        if (it[-1]->slot == slot)
+        {
+            return it[-1];
+        }
+        it--;
+    }
+
+    auto upvalue = new Upvalue(&registers, slot);
+    upvalue->retain();
+    open_captures.insert(it, upvalue);
+    return upvalue;
+}
+
+// the registers from level up are going out of scope
+void VM::close_captures(size_t level)
+{
+    while (!open_captures.empty() && open_captures.back()->slot >= level)
+    {
+        open_captures.back()->close();
+        open_captures.back()->release();
+        open_captures.pop_back();
+    }
+}
+
+void VM::run()
+{
+    auto main = program->protos[0].get();
+    registers.resize(std::max<size_t>(registers.size(), main->num_registers + 1));
+    frames.push_back(Frame{main, nullptr, main->code.data(), 0});
+
+    size_t max_depth = max_call_depth();
+
+    Frame *frame;
+    const Instruction *code;
+    const Instruction *pc;
+    Value *R;
+    Value *K;
+
+#define RELOAD()                                  \
+    do                                            \
+    {                                             \
+        frame = &frames.back();                   \
+        code = frame->proto->code.data();         \
+        pc = frame->pc;                           \
+        R = registers.data() + frame->base;       \
+        K = frame->proto->constants.data();       \
+    } while (0)
+
+// int operands are handled inline, everything else goes through the Value dispatch table
+#define ARITH(INT_EXPR)                                                          \
+    if (R[i.b].type == MyType::MYINT && R[i.c].type == MyType::MYINT)            \
+    {                                                                            \
+        int l = R[i.b].int_value, r = R[i.c].int_value;                          \
+        set_int(R[i.a], INT_EXPR);                                               \
+    }                                                                            \
+    else                                                                         \
+    {                                                                            \
+        Value result = Value::binary((BinaryOperator)(i.op - OP_ADD), R[i.b], R[i.c]); \
+        R[i.a] = result;                                                         \
+    }
+
+#define COMPARE(OPERATOR)                                                        \
+    if (R[i.b].type == MyType::MYINT && R[i.c].type == MyType::MYINT)            \
+    {                                                                            \
+        set_bool(R[i.a], R[i.b].int_value OPERATOR R[i.c].int_value);            \
+    }                                                                            \
+    else                                                                         \
+    {                                                                            \
+        Value result = Value::binary((BinaryOperator)(i.op - OP_ADD), R[i.b], R[i.c]); \
+        R[i.a] = result;                                                         \
+    }
+
+// the TypeChecker proved both operands have the type, so there is nothing to check
+#define INT_ARITH(INT_EXPR)                                  \
+    {                                                        \
+        int l = R[i.b].int_value, r = R[i.c].int_value;      \
+        set_int(R[i.a], INT_EXPR);                           \
+    }
+
+#define INT_COMPARE(OPERATOR) set_bool(R[i.a], R[i.b].int_value OPERATOR R[i.c].int_value);
+
+#define FLOAT_ARITH(FLOAT_EXPR)                              \
+    {                                                        \
+        float l = R[i.b].float_value, r = R[i.c].float_value; \
+        set_float(R[i.a], FLOAT_EXPR);                       \
+    }
+
+#define FLOAT_COMPARE(OPERATOR) set_bool(R[i.a], R[i.b].float_value OPERATOR R[i.c].float_value);
+
+    RELOAD();
+
+    for (;;)
+    {
+        const Instruction &i = *pc++;
+        switch (i.op)
+        {
+        case OP_LOADK:
+            R[i.a] = K[i.bx()];
+            break;
+        case OP_LOADI:
+            set_int(R[i.a], (int)i.bx());
+            break;
+        case OP_LOADNONE:
+            R[i.a] = Value();
+            break;
+        case OP_LOADBOOL:
+            set_bool(R[i.a], i.b != 0);
+            break;
+        case OP_MOVE:
+            R[i.a] = R[i.b];
+            break;
+        case OP_GETGLOBAL:
+            if (!defined[i.bx()])
+            {
+                error("Variable " + program->globals[i.bx()] + " not defined");
+            }
+            R[i.a] = globals[i.bx()];
+            break;
+        case OP_SETGLOBAL:
+            if (!defined[i.bx()])
+            {
+                error("Variable " + program->globals[i.bx()] + " not defined");
+            }
+            globals[i.bx()] = R[i.a];
+            break;
+        case OP_DEFGLOBAL:
+            globals[i.bx()] = R[i.a];
+            defined[i.bx()] = true;
+            break;
+        case OP_GETCAPTURE:
+            R[i.a] = frame->closure->captures[i.b]->value();
+            break;
+        case OP_SETCAPTURE:
+            frame->closure->captures[i.b]->value() = R[i.a];
+            break;
+        case OP_CLOSECAPTURES:
+            close_captures(frame->base + i.a);
+            break;
+        case OP_ADD:
+            ARITH(l + r)
+            break;
+        case OP_SUB:
+            ARITH(l - r)
+            break;
+        case OP_MUL:
+            ARITH(l * r)
+            break;
+        case OP_DIV:
+            ARITH(l / checked_int_divisor(r))
+            break;
+        case OP_MOD:
+            ARITH(l % checked_int_divisor(r))
+            break;
+        case OP_POW:
+            ARITH(int_pow(l, r))
+            break;
+        case OP_EQ:
+            COMPARE(==)
+            break;
+        case OP_NE:
+            COMPARE(!=)
+            break;
+        case OP_LT:
+            COMPARE(<)
+            break;
+        case OP_LE:
+            COMPARE(<=)
+            break;
+        case OP_GT:
+            COMPARE(>)
+            break;
+        case OP_GE:
+            COMPARE(>=)
+            break;
+        case OP_ADDI:
+            INT_ARITH(l + r)
+            break;
+        case OP_SUBI:
+            INT_ARITH(l - r)
+            break;
+        case OP_MULI:
+            INT_ARITH(l * r)
+            break;
+        case OP_DIVI:
+            INT_ARITH(l / checked_int_divisor(r))
+            break;
+        case OP_MODI:
+            INT_ARITH(l % checked_int_divisor(r))
+            break;
+        case OP_POWI:
+            INT_ARITH(int_pow(l, r))
+            break;
+        case OP_EQI:
+            INT_COMPARE(==)
+            break;
+        case OP_NEI:
+            INT_COMPARE(!=)
+            break;
+        case OP_LTI:
+            INT_COMPARE(<)
+            break;
+        case OP_LEI:
+            INT_COMPARE(<=)
+            break;
+        case OP_GTI:
+            INT_COMPARE(>)
+            break;
+        case OP_GEI:
+            INT_COMPARE(>=)
+            break;
+        case OP_ADDF:
+            FLOAT_ARITH(l + r)
+            break;
+        case OP_SUBF:
+            FLOAT_ARITH(l - r)
+            break;
+        case OP_MULF:
+            FLOAT_ARITH(l * r)
+            break;
+        case OP_DIVF:
+            FLOAT_ARITH(l / r)
+            break;
+        case OP_POWF:
+            FLOAT_ARITH(std::pow(l, r))
+            break;
+        case OP_EQF:
+            FLOAT_COMPARE(==)
+            break;
+        case OP_NEF:
+            FLOAT_COMPARE(!=)
+            break;
+        case OP_LTF:
+            FLOAT_COMPARE(<)
+            break;
+        case OP_LEF:
+            FLOAT_COMPARE(<=)
+            break;
+        case OP_GTF:
+            FLOAT_COMPARE(>)
+            break;
+        case OP_GEF:
+            FLOAT_COMPARE(>=)
+            break;
+        case OP_MODF:
+        {
+            // float modulo isn't defined, so the checker never lets this through
+            Value result = Value::binary(BINARY_MOD, R[i.b], R[i.c]);
+            R[i.a] = result;
+            break;
+        }
+        case OP_NEG:
+        case OP_NOT:
+        {
+            Value result = Value::unary((UnaryOperator)(i.op - OP_NEG), R[i.b]);
+            R[i.a] = result;
+            break;
+        }
+        case OP_JMP:
+            pc = code + i.bx();
+            break;
+        case OP_JMPF:
+        case OP_JMPT:
+            if (R[i.a].type != MyType::MYBOOL)
+            {
+                error("Expected boolean value in condition");
+            }
+            if (R[i.a].bool_value == (i.op == OP_JMPT))
+            {
+                pc = code + i.bx();
+            }
+            break;
+        case OP_JMPDEF:
+            if (defined[i.a])
+            {
+                pc = code + i.bx();
+            }
+            break;
+        case OP_NEWARRAY:
+            R[i.a] = Value(new Array(std::vector<Value>(R + i.b, R + i.b + i.c)));
+            break;
+        case OP_GETINDEX:
+        {
+            if (R[i.b].type != MyType::MYARRAY)
+            {
+                error("Expected array value in index expression");
+            }
+            if (R[i.c].type != MyType::MYINT)
+            {
+                error("Array index must be an integer");
+            }
+            auto array = R[i.b].array;
+            if (R[i.c].int_value < 0 || R[i.c].int_value >= array->size())
+            {
+                error("Array index out of range");
+            }
+            Value element = (*array)[R[i.c].int_value];
+            R[i.a] = element;
+            break;
+        }
+        case OP_SETINDEX:
+            if (R[i.a].type != MyType::MYARRAY)
+            {
+                error("Expected array value in index assignment");
+            }
+            if (R[i.b].type != MyType::MYINT)
+            {
+                error("Array index must be an integer");
+            }
+            R[i.a].array->set(R[i.b], R[i.c]);
+            break;
+        case OP_CLOSURE:
+        {
+            auto proto = program->protos[i.bx()].get();
+            auto callable = new Callable(proto);
+            R[i.a] = Value(callable);
+            for (auto &capture : proto->captures)
+            {
+                auto upvalue = capture.from_register ? this->capture(frame->base + capture.index) : frame->closure->captures[capture.index];
+                upvalue->retain();
+                callable->captures.push_back(upvalue);
+            }
+            break;
+        }
+        case OP_CALL:
+        case OP_CALLG:
+        case OP_TAILCALL:
+        case OP_TAILCALLG:
+        {
+            bool tail = i.op == OP_TAILCALL || i.op == OP_TAILCALLG;
+            Value *callee;
+            if (i.op == OP_CALL || i.op == OP_TAILCALL)
+            {
+                callee = &R[i.b];
+            }
+            else if (defined[i.b])
+            {
+                callee = &globals[i.b];
+            }
+            else if (natives[i.b] != nullptr)
+            {
+                // not checked statically, since the call was typed against the function
+                if (!natives[i.b]->takes(i.c))
+                {
+                    error("Wrong number of arguments to " + program->globals[i.b]);
+                }
+                Value result = natives[i.b]->function(std::vector<Value>(R + i.a, R + i.a + i.c));
+                if (tail)
+                {
+                    close_captures(frame->base);
+                    R[0] = result;
+                    frame->closure->release();
+                    frames.pop_back();
+                    RELOAD();
+                    break;
+                }
+                R[i.a] = result;
+                break;
+            }
+            else
+            {
+                error("Function " + program->globals[i.b] + " not defined");
+            }
+
+            if (callee->type != MyType::MYFUNCTION || callee->callable->proto == nullptr)
+            {
+                error("Can only call functions");
+            }
+
+            auto callable = callee->callable;
+            auto proto = callable->proto;
+            if (i.c > proto->num_params)
+            {
+                error("Too many arguments to " + proto->name);
+            }
+
+            // a tail call moves its arguments down to the current frame's base and takes the
+            // frame over, so the caller's frame is gone before the callee runs
+            size_t base = tail ? frame->base : frame->base + i.a;
+            if (!tail && frames.size() > max_depth)
+            {
+                error("Maximum call depth of " + std::to_string(max_depth) + " exceeded");
+            }
+
+            frame->pc = pc;
+            if (registers.size() < base + proto->num_registers + 1)
+            {
+                registers.resize(std::max(registers.size() * 2, base + proto->num_registers + 1));
+                R = registers.data() + frame->base;
+            }
+
+            // the frame owns a reference so reassigning the callee's variable can't free it mid-call
+            callable->retain();
+            if (tail)
+            {
+                close_captures(frame->base);
+                for (size_t k = 0; k < i.c && i.a != 0; k++)
+                {
+                    R[k] = std::move(R[i.a + k]);
+                }
+                frame->closure->release();
+                frames.pop_back();
+            }
+
+            for (size_t k = i.c; k < proto->num_params; k++)
+            {
+                registers[base + k] = Value();
+            }
+
+            frames.push_back(Frame{proto, callable, proto->code.data(), base});
+            RELOAD();
+            break;
+        }
+        case OP_CALLN:
+            R[i.a] = StandardLib::natives()[i.b].function(std::vector<Value>(R + i.a, R + i.a + i.c));
+            break;
+        case OP_RETURN:
+        case OP_RETURNNONE:
+        {
+            Value result = i.op == OP_RETURN ? R[i.a] : Value();
+            close_captures(frame->base);
+            R[0] = result;
+            frame->closure->release();
+            frames.pop_back();
+            RELOAD();
+            break;
+        }
+        case OP_FORPREP:
+            if (R[i.a].type != MyType::MYSTRING && R[i.a].type != MyType::MYARRAY)
+            {
+                error("Expected string or array value in for statement iterable");
+            }
+            set_int(R[i.a + 1], 0);
+            break;
+        case OP_FORNEXT:
+        {
+            int index = R[i.a + 1].int_value;
+            if (R[i.a].type == MyType::MYARRAY && R[i.a].array->lazy)
+            {
+                auto range = R[i.a].array;
+                if (index >= range->count)
+                {
+                    pc = code + i.bx();
+                    break;
+                }
+                set_int(R[i.a + 2], range->at(index));
+            }
+            else if (R[i.a].type == MyType::MYARRAY)
+            {
+                auto &elements = R[i.a].array->elements;
+                if (index >= elements.size())
+                {
+                    pc = code + i.bx();
+                    break;
+                }
+                Value element = elements[index];
+                R[i.a + 2] = element;
+            }
+            else
+            {
+                if (index >= R[i.a].length())
+                {
+                    pc = code + i.bx();
+                    break;
+                }
+                R[i.a + 2] = Value(std::string(1, R[i.a].chars()[index]));
+            }
+            R[i.a + 1].int_value++;
+            break;
+        }
+        case OP_OPEN:
+        {
+            static const DHTT::Kind kinds[] = {DHTT::AND, DHTT::OR, DHTT::THEN, DHTT::PSEUDO};
+            tree.open(kinds[i.a]);
+            break;
+        }
+        case OP_CLOSE:
+            tree.close();
+            break;
+        case OP_BEHAVIOR:
+            tree.add_string(K[i.a].str());
+            for (uint16_t k = 0; k < i.c; k++)
+            {
+                tree.add_string(R[i.b + k].to_string());
+            }
+            tree.end_behavior();
+            break;
+        case OP_LOAD:
+            load(std::vector<Value>(R + i.b, R + i.b + i.c), i.a != 0);
+            break;
+        case OP_HALT:
+            close_captures(0);
+            frames.pop_back();
+            return;
+        }
+    }
+
+#undef RELOAD
+#undef ARITH
+#undef COMPARE
+#undef INT_ARITH
+#undef INT_COMPARE
+#undef FLOAT_ARITH
+#undef FLOAT_COMPARE
+}